@@ -0,0 +1,119 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <string_view>
+
+#include "corral/corral.h"
+
+#if defined(__linux__)
+#include <poll.h>
+
+#include "corral/EventFdPoster.h"
+#endif
+
+/// Small harness shared by the corral_bench translation units.
+///
+/// Every benchmark reports exactly one JSON object per line on stdout:
+///
+///    {"bench":"channel.pingPong","iterations":100000,"ns_per_op":85.31,
+///     "allocs_per_op":0.000}
+///
+/// so results from two commits can be compared with a plain `diff` or
+/// loaded into any tool that understands JSON lines.
+namespace corral_bench {
+
+/// Selects which benchmarks to run; an empty pattern matches everything,
+/// otherwise a benchmark runs if its name contains the pattern.
+struct Filter {
+    std::string_view pattern;
+
+    bool matches(std::string_view name) const noexcept {
+        return pattern.empty() || name.find(pattern) != std::string_view::npos;
+    }
+};
+
+/// Number of calls to global operator new since program start.
+size_t allocationCount() noexcept;
+
+/// Prints a single result line.
+void report(std::string_view name,
+            size_t iterations,
+            std::chrono::nanoseconds elapsed,
+            size_t allocations);
+
+/// Measures wall-clock time and heap allocations between construction
+/// and stop(). Setup and teardown should be kept outside of that window.
+class Measurement {
+  public:
+    explicit Measurement(std::string_view name, size_t iterations)
+      : name_(name),
+        iterations_(iterations),
+        allocations_(allocationCount()),
+        start_(std::chrono::steady_clock::now()) {}
+
+    void stop() {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        report(name_, iterations_,
+               std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed),
+               allocationCount() - allocations_);
+    }
+
+  private:
+    std::string_view name_;
+    size_t iterations_;
+    size_t allocations_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+/// A trivial event loop for benchmarks which never wait on I/O;
+/// everything they do completes within the executor.
+struct BenchLoop {};
+
+#if defined(__linux__)
+/// An event loop which, unlike BenchLoop, can be woken up from other
+/// threads, for benchmarks involving Executor::runSoonFromThread().
+struct PollLoop {
+    corral::EventFdPoster poster;
+    bool stopped = false;
+};
+#endif
+
+void runCoreBenches(Filter filter);
+
+/// Runs the benchmarks for the Qt layer; must be started from within
+/// a running QCoreApplication (see CorralQt::run()).
+corral::Task<void> runQtBenches(Filter filter);
+
+} // namespace corral_bench
+
+namespace corral {
+template <> struct EventLoopTraits<corral_bench::BenchLoop> {
+    static EventLoopID eventLoopID(corral_bench::BenchLoop& loop) {
+        return EventLoopID(&loop);
+    }
+    static void run(corral_bench::BenchLoop&) {}
+    static void stop(corral_bench::BenchLoop&) {}
+};
+
+#if defined(__linux__)
+template <> struct EventLoopTraits<corral_bench::PollLoop> {
+    static EventLoopID eventLoopID(corral_bench::PollLoop& loop) {
+        return EventLoopID(&loop);
+    }
+    static void run(corral_bench::PollLoop& loop) {
+        loop.stopped = false;
+        while (!loop.stopped) {
+            pollfd pfd{loop.poster.fd(), POLLIN, 0};
+            ::poll(&pfd, 1, -1);
+            loop.poster.dispatch();
+        }
+    }
+    static void stop(corral_bench::PollLoop& loop) { loop.stopped = true; }
+    static void post(corral_bench::PollLoop& loop,
+                     void (*fn)(void*),
+                     void* arg) {
+        loop.poster.post(fn, arg);
+    }
+};
+#endif
+} // namespace corral
@@ -0,0 +1,647 @@
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bench.h"
+#include "corral/AsyncMutex.h"
+#include "corral/ThreadChannel.h"
+
+namespace corral_bench {
+namespace {
+
+using corral::Task;
+
+Task<void> trivialTask() { co_return; }
+
+Task<void> yieldingTask() { co_await corral::yield; }
+
+Task<void> parkedTask() { co_await corral::SuspendForever{}; }
+
+//
+// Nursery
+//
+
+void benchNurseryStart(Filter filter) {
+    constexpr size_t N = 100000;
+    BenchLoop loop;
+
+    if (filter.matches("nursery.start")) {
+        Measurement m("nursery.start", N);
+        corral::run(loop, [&]() -> Task<void> {
+            CORRAL_WITH_NURSERY(nursery) {
+                for (size_t i = 0; i < N; ++i) {
+                    nursery.start(trivialTask);
+                }
+                co_return corral::join;
+            };
+        }());
+        m.stop();
+    }
+
+    if (filter.matches("nursery.startWithArgs")) {
+        Measurement m("nursery.startWithArgs", N);
+        corral::run(loop, [&]() -> Task<void> {
+            CORRAL_WITH_NURSERY(nursery) {
+                for (size_t i = 0; i < N; ++i) {
+                    nursery.start(
+                            [](size_t) -> Task<void> { co_return; }, i);
+                }
+                co_return corral::join;
+            };
+        }());
+        m.stop();
+    }
+
+    if (filter.matches("nursery.startWithArgsWrapped")) {
+        // Same as above, but the capture forces the callable to be kept
+        // alive by a wrapper coroutine.
+        size_t unused = 0;
+        Measurement m("nursery.startWithArgsWrapped", N);
+        corral::run(loop, [&]() -> Task<void> {
+            CORRAL_WITH_NURSERY(nursery) {
+                for (size_t i = 0; i < N; ++i) {
+                    nursery.start(
+                            [&unused](size_t) -> Task<void> { co_return; },
+                            i);
+                }
+                co_return corral::join;
+            };
+        }());
+        m.stop();
+    }
+
+    if (filter.matches("nursery.cancel1M")) {
+        // Cancelling a nursery full of parked tasks; measures only
+        // the cancellation, not starting the tasks.
+        constexpr size_t Parked = 1000000;
+        std::optional<Measurement> m;
+        corral::run(loop, [&]() -> Task<void> {
+            CORRAL_WITH_NURSERY(nursery) {
+                for (size_t i = 0; i < Parked; ++i) {
+                    nursery.start(parkedTask);
+                }
+                co_await corral::yield;
+                m.emplace("nursery.cancel1M", Parked);
+                co_return corral::cancel;
+            };
+        }());
+        m->stop();
+    }
+}
+
+//
+// Executor
+//
+
+void benchExecutor(Filter filter) {
+    constexpr size_t Batch = 1024;
+    constexpr size_t N = Batch * 1024;
+    if (!filter.matches("executor.scheduleDrain")) {
+        return;
+    }
+
+    BenchLoop loop;
+    corral::Executor executor(loop, nullptr);
+    size_t counter = 0;
+
+    Measurement m("executor.scheduleDrain", N);
+    for (size_t done = 0; done < N; done += Batch) {
+        for (size_t i = 0; i < Batch; ++i) {
+            executor.schedule(+[](size_t* c) noexcept { ++*c; }, &counter);
+        }
+        executor.runSoon();
+    }
+    m.stop();
+    CORRAL_ASSERT(counter == N);
+}
+
+void benchCapture(Filter filter) {
+    // Roughly what every Nursery::cancel() and CBPortal wakeup does.
+    constexpr size_t N = 100000;
+    if (!filter.matches("executor.capture")) {
+        return;
+    }
+
+    BenchLoop loop;
+    corral::Executor executor(loop, nullptr);
+    size_t counter = 0;
+
+    Measurement m("executor.capture", N);
+    for (size_t i = 0; i < N; ++i) {
+        executor.capture([&] {
+            executor.schedule(+[](size_t* c) noexcept { ++*c; }, &counter);
+        });
+    }
+    m.stop();
+    CORRAL_ASSERT(counter == N);
+}
+
+//
+// Channel
+//
+
+void benchChannel(Filter filter) {
+    constexpr size_t N = 100000;
+    if (!filter.matches("channel.pingPong")) {
+        return;
+    }
+
+    BenchLoop loop;
+    corral::Channel<size_t> ping(1);
+    corral::Channel<size_t> pong(1);
+
+    Measurement m("channel.pingPong", N);
+    corral::run(loop, corral::allOf(
+                              [&]() -> Task<void> {
+                                  for (size_t i = 0; i < N; ++i) {
+                                      co_await ping.send(i);
+                                      co_await pong.receive();
+                                  }
+                              }(),
+                              [&]() -> Task<void> {
+                                  for (size_t i = 0; i < N; ++i) {
+                                      auto v = co_await ping.receive();
+                                      co_await pong.send(*v);
+                                  }
+                              }()));
+    m.stop();
+}
+
+void benchChannelStream(Filter filter) {
+    // A producer streaming into a bounded channel, one object at a time
+    // vs. in batches.
+    constexpr size_t N = 1000000;
+    constexpr size_t Capacity = 64;
+    BenchLoop loop;
+
+    if (filter.matches("channel.stream.single")) {
+        corral::Channel<size_t> ch(Capacity);
+        Measurement m("channel.stream.single", N);
+        corral::run(loop, corral::allOf(
+                                  [&]() -> Task<void> {
+                                      for (size_t i = 0; i < N; ++i) {
+                                          co_await ch.send(i);
+                                      }
+                                      ch.close();
+                                  }(),
+                                  [&]() -> Task<void> {
+                                      while (co_await ch.receive()) {
+                                      }
+                                  }()));
+        m.stop();
+    }
+
+    if (filter.matches("channel.stream.batched")) {
+        corral::Channel<size_t> ch(Capacity);
+        std::vector<size_t> src(Capacity);
+        Measurement m("channel.stream.batched", N);
+        corral::run(loop, corral::allOf(
+                                  [&]() -> Task<void> {
+                                      for (size_t sent = 0; sent < N;) {
+                                          sent += co_await ch.sendMany(
+                                                  std::span(src).first(
+                                                          std::min(Capacity,
+                                                                   N - sent)));
+                                      }
+                                      ch.close();
+                                  }(),
+                                  [&]() -> Task<void> {
+                                      size_t buf[Capacity];
+                                      while (co_await ch.receiveMany(buf)) {
+                                      }
+                                  }()));
+        m.stop();
+    }
+}
+
+void benchChannelSlots(Filter filter) {
+    // Passing 1 KiB blocks through a bounded channel, by value
+    // vs. constructing and consuming them in place.
+    constexpr size_t N = 200000;
+    constexpr size_t Capacity = 16;
+    struct Block {
+        size_t seq;
+        std::array<char, 1024> data;
+    };
+    BenchLoop loop;
+
+    if (filter.matches("channel.block1k.send")) {
+        corral::Channel<Block> ch(Capacity);
+        size_t received = 0;
+        Measurement m("channel.block1k.send", N);
+        corral::run(loop, corral::allOf(
+                                  [&]() -> Task<void> {
+                                      for (size_t i = 0; i < N; ++i) {
+                                          Block b;
+                                          b.seq = i;
+                                          b.data.fill(char(i));
+                                          co_await ch.send(std::move(b));
+                                      }
+                                      ch.close();
+                                  }(),
+                                  [&]() -> Task<void> {
+                                      while (auto b = co_await ch.receive()) {
+                                          received += b->data[0] ==
+                                                      char(b->seq);
+                                      }
+                                  }()));
+        m.stop();
+        CORRAL_ASSERT(received == N);
+    }
+
+    if (filter.matches("channel.block1k.slots")) {
+        corral::Channel<Block> ch(Capacity);
+        size_t received = 0;
+        Measurement m("channel.block1k.slots", N);
+        corral::run(loop, corral::allOf(
+                                  [&]() -> Task<void> {
+                                      for (size_t i = 0; i < N; ++i) {
+                                          auto slot = co_await ch.reserve();
+                                          Block& b = slot.emplace();
+                                          b.seq = i;
+                                          b.data.fill(char(i));
+                                          slot.commit();
+                                      }
+                                      ch.close();
+                                  }(),
+                                  [&]() -> Task<void> {
+                                      while (auto b = co_await ch.peek()) {
+                                          received += b->data[0] ==
+                                                      char(b->seq);
+                                          b.consume();
+                                      }
+                                  }()));
+        m.stop();
+        CORRAL_ASSERT(received == N);
+    }
+}
+
+void benchBroadcast(Filter filter) {
+    // One producer, four consumers each seeing every object: through
+    // a BroadcastChannel vs. one Channel per consumer.
+    constexpr size_t N = 200000;
+    constexpr size_t Capacity = 64;
+    constexpr size_t Consumers = 4;
+    BenchLoop loop;
+
+    if (filter.matches("channel.fanout4.channels")) {
+        std::vector<std::unique_ptr<corral::Channel<size_t>>> channels;
+        for (size_t i = 0; i < Consumers; ++i) {
+            channels.push_back(
+                    std::make_unique<corral::Channel<size_t>>(Capacity));
+        }
+        size_t received = 0;
+        Measurement m("channel.fanout4.channels", N);
+        corral::run(loop, [&]() -> Task<void> {
+            CORRAL_WITH_NURSERY(n) {
+                for (auto& ch : channels) {
+                    n.start([&ch, &received]() -> Task<void> {
+                        while (co_await ch->receive()) {
+                            ++received;
+                        }
+                    });
+                }
+                for (size_t i = 0; i < N; ++i) {
+                    for (auto& ch : channels) {
+                        co_await ch->send(i);
+                    }
+                }
+                for (auto& ch : channels) {
+                    ch->close();
+                }
+                co_return corral::join;
+            };
+        }());
+        m.stop();
+        CORRAL_ASSERT(received == N * Consumers);
+    }
+
+    if (filter.matches("channel.fanout4.broadcast")) {
+        corral::BroadcastChannel<size_t> ch(Capacity);
+        size_t received = 0;
+        Measurement m("channel.fanout4.broadcast", N);
+        corral::run(loop, [&]() -> Task<void> {
+            CORRAL_WITH_NURSERY(n) {
+                for (size_t i = 0; i < Consumers; ++i) {
+                    n.start([&received](auto sub) -> Task<void> {
+                        while (co_await sub.receive()) {
+                            ++received;
+                        }
+                    }, ch.subscribe());
+                }
+                for (size_t i = 0; i < N; ++i) {
+                    co_await ch.send(i);
+                }
+                ch.close();
+                co_return corral::join;
+            };
+        }());
+        m.stop();
+        CORRAL_ASSERT(received == N * Consumers);
+    }
+}
+
+//
+// ThreadChannel
+//
+
+/// The simplest thing a ThreadChannel can be compared against:
+/// a bounded deque behind a mutex and two condition variables.
+template <class T> class MutexQueue {
+  public:
+    explicit MutexQueue(size_t capacity) : capacity_(capacity) {}
+
+    void push(T value) {
+        std::unique_lock lk(mutex_);
+        notFull_.wait(lk, [&] { return items_.size() < capacity_; });
+        items_.push_back(std::move(value));
+        notEmpty_.notify_one();
+    }
+
+    std::optional<T> pop() {
+        std::unique_lock lk(mutex_);
+        notEmpty_.wait(lk, [&] { return !items_.empty() || closed_; });
+        if (items_.empty()) {
+            return std::nullopt;
+        }
+        T ret = std::move(items_.front());
+        items_.pop_front();
+        notFull_.notify_one();
+        return ret;
+    }
+
+    void close() {
+        std::lock_guard lk(mutex_);
+        closed_ = true;
+        notEmpty_.notify_all();
+    }
+
+  private:
+    size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::deque<T> items_;
+    bool closed_ = false;
+};
+
+void benchThreadChannel(Filter filter) {
+    constexpr size_t N = 1000000;
+    constexpr size_t Capacity = 1024;
+
+    /// Runs `producers` threads each sending N / producers objects
+    /// through `send()`, then closes the channel with `close()`.
+    auto produce = [](size_t producers, auto send, auto close) {
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < producers; ++p) {
+            threads.emplace_back([=] {
+                for (size_t i = 0; i < N / producers; ++i) {
+                    send(i);
+                }
+            });
+        }
+        return std::thread([=, threads = std::move(threads)]() mutable {
+            for (auto& t : threads) {
+                t.join();
+            }
+            close();
+        });
+    };
+
+    /// Runs the mutex+condvar baseline, then the same through
+    /// ThreadChannel `Channel`, received from a thread and from a task.
+    auto run = [&]<class Channel>(std::type_identity<Channel>,
+                                  size_t producers, std::string suffix) {
+        std::string name = "threadChannel.mutexCondvar" + suffix;
+        if (filter.matches(name)) {
+            MutexQueue<size_t> q(Capacity);
+            Measurement m(name, N);
+            std::thread t = produce(
+                    producers, [&q](size_t i) { q.push(i); },
+                    [&q] { q.close(); });
+            while (q.pop()) {
+            }
+            m.stop();
+            t.join();
+        }
+
+        name = "threadChannel.blocking" + suffix;
+        if (filter.matches(name)) {
+            Channel ch(Capacity);
+            Measurement m(name, N);
+            std::thread t = produce(
+                    producers, [&ch](size_t i) { ch.sendBlocking(i); },
+                    [&ch] { ch.close(); });
+            while (ch.receiveBlocking()) {
+            }
+            m.stop();
+            t.join();
+        }
+
+#if defined(__linux__)
+        name = "threadChannel.toLoop" + suffix;
+        if (filter.matches(name)) {
+            PollLoop loop;
+            Channel ch(Capacity);
+            Measurement m(name, N);
+            std::thread t = produce(
+                    producers, [&ch](size_t i) { ch.sendBlocking(i); },
+                    [&ch] { ch.close(); });
+            corral::run(loop, [&]() -> Task<void> {
+                while (co_await ch.receive()) {
+                }
+            }());
+            m.stop();
+            t.join();
+        }
+#endif
+    };
+
+    using corral::Producers;
+    run(std::type_identity<
+                corral::ThreadChannel<size_t, Producers::Single>>{},
+        1, ".spsc");
+    run(std::type_identity<
+                corral::ThreadChannel<size_t, Producers::Multiple>>{},
+        4, ".mpsc4");
+}
+
+//
+// Wakeups
+//
+
+void benchWakeAll(Filter filter) {
+    // Waking a crowd of tasks parked in the same ParkingLot, over
+    // and over. The anyOf() variant adds a combinator between each
+    // task and the lot, whose wakeups are not deferred to the executor
+    // by themselves.
+    constexpr size_t Waiters = 1000;
+    constexpr size_t Rounds = 200;
+    BenchLoop loop;
+
+    auto run = [&](const char* name, auto parkFn) {
+        if (!filter.matches(name)) {
+            return;
+        }
+        corral::ParkingLot lot;
+        size_t parked = 0;
+        size_t woken = 0;
+        Measurement m(name, Waiters * Rounds);
+        corral::run(loop, [&]() -> Task<void> {
+            CORRAL_WITH_NURSERY(n) {
+                for (size_t i = 0; i < Waiters; ++i) {
+                    n.start([&]() -> Task<void> {
+                        for (;;) {
+                            ++parked;
+                            co_await parkFn(lot);
+                            --parked;
+                            ++woken;
+                        }
+                    });
+                }
+                for (size_t r = 0; r < Rounds; ++r) {
+                    while (parked < Waiters || woken < r * Waiters) {
+                        co_await corral::yield;
+                    }
+                    lot.unparkAll();
+                }
+                co_return corral::cancel;
+            };
+        }());
+        m.stop();
+    };
+
+    run("parkingLot.wake1k.direct",
+        [](corral::ParkingLot& lot) { return lot.park(); });
+    run("parkingLot.wake1k.anyOf", [](corral::ParkingLot& lot) {
+        return corral::anyOf(lot.park(), corral::SuspendForever{});
+    });
+}
+
+//
+// Locks
+//
+
+void benchMutex(Filter filter) {
+    constexpr size_t N = 100000;
+    constexpr size_t Tasks = 4;
+    BenchLoop loop;
+
+    // Lock and unlock with nobody else around
+    auto uncontended = [&](const char* name, auto& mutex, auto lockFn) {
+        if (!filter.matches(name)) {
+            return;
+        }
+        Measurement m(name, N);
+        corral::run(loop, [&]() -> Task<void> {
+            for (size_t i = 0; i < N; ++i) {
+                auto lk = co_await lockFn(mutex);
+            }
+        }());
+        m.stop();
+    };
+
+    // Several tasks taking turns holding the lock across a yield
+    auto contended = [&](const char* name, auto& mutex) {
+        if (!filter.matches(name)) {
+            return;
+        }
+        Measurement m(name, N);
+        corral::run(loop, [&]() -> Task<void> {
+            CORRAL_WITH_NURSERY(n) {
+                for (size_t t = 0; t < Tasks; ++t) {
+                    n.start([&]() -> Task<void> {
+                        for (size_t i = 0; i < N / Tasks; ++i) {
+                            auto lk = co_await mutex.lock();
+                            co_await corral::yield;
+                        }
+                    });
+                }
+                co_return corral::join;
+            };
+        }());
+        m.stop();
+    };
+
+    auto lock = [](auto& mutex) { return mutex.lock(); };
+    auto lockShared = [](auto& mutex) { return mutex.lockShared(); };
+
+    corral::Semaphore sem;
+    corral::AsyncMutex mutex;
+    corral::AsyncSharedMutex shared;
+    uncontended("mutex.uncontended.semaphore", sem, lock);
+    uncontended("mutex.uncontended.asyncMutex", mutex, lock);
+    uncontended("mutex.uncontended.sharedExclusive", shared, lock);
+    uncontended("mutex.uncontended.sharedShared", shared, lockShared);
+    contended("mutex.contended4.semaphore", sem);
+    contended("mutex.contended4.asyncMutex", mutex);
+    contended("mutex.contended4.sharedExclusive", shared);
+}
+
+//
+// anyOf() / allOf() over ranges
+//
+
+void benchWait(Filter filter) {
+    constexpr size_t N = 2000;
+    constexpr size_t FanIn = 64;
+    BenchLoop loop;
+
+    auto makeTasks = [] {
+        std::vector<Task<void>> tasks;
+        tasks.reserve(FanIn);
+        for (size_t i = 0; i < FanIn; ++i) {
+            tasks.push_back(yieldingTask());
+        }
+        return tasks;
+    };
+
+    if (filter.matches("wait.anyOfRange64")) {
+        Measurement m("wait.anyOfRange64", N);
+        corral::run(loop, [&]() -> Task<void> {
+            for (size_t i = 0; i < N; ++i) {
+                co_await corral::anyOf(makeTasks());
+            }
+        }());
+        m.stop();
+    }
+
+    if (filter.matches("wait.allOfRange64")) {
+        Measurement m("wait.allOfRange64", N);
+        corral::run(loop, [&]() -> Task<void> {
+            for (size_t i = 0; i < N; ++i) {
+                co_await corral::allOf(makeTasks());
+            }
+        }());
+        m.stop();
+    }
+}
+
+} // namespace
+
+void runCoreBenches(Filter filter) {
+    benchNurseryStart(filter);
+    benchExecutor(filter);
+    benchCapture(filter);
+    benchChannel(filter);
+    benchChannelStream(filter);
+    benchChannelSlots(filter);
+    benchBroadcast(filter);
+    benchThreadChannel(filter);
+    benchWakeAll(filter);
+    benchMutex(filter);
+    benchWait(filter);
+}
+
+} // namespace corral_bench
+
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <chrono>
+
+#include <QBuffer>
+#include <QByteArray>
+
+#include "bench.h"
+#include "corral/qt/corralqiodevice.h"
+#include "corral/qt/corralqt.h"
+
+namespace corral_bench {
+namespace {
+
+using namespace std::chrono_literals;
+using corral::Task;
+
+//
+// Timers
+//
+
+Task<void> benchTimers(Filter filter) {
+    if (filter.matches("qt.sleepCancel")) {
+        // Arms a timer and cancels it right away; this is what every
+        // qAwaitTimeout() around an already-available read boils down to.
+        constexpr size_t N = 20000;
+        Measurement m("qt.sleepCancel", N);
+        for (size_t i = 0; i < N; ++i) {
+            co_await corral::anyOf(qSleepFor(1h), corral::Yield{});
+        }
+        m.stop();
+    }
+
+    if (filter.matches("qt.sleepFire")) {
+        constexpr size_t N = 2000;
+        Measurement m("qt.sleepFire", N);
+        for (size_t i = 0; i < N; ++i) {
+            co_await qSleepForNs(1);
+        }
+        m.stop();
+    }
+
+    if (filter.matches("qt.concurrentSleeps")) {
+        // Many timers pending at once, as with thousands of concurrent
+        // reads under qAwaitTimeout(); arming and cancelling each one
+        // should not depend on how many others there are.
+        constexpr size_t N = 10000;
+        Measurement m("qt.concurrentSleeps", N);
+        CORRAL_WITH_NURSERY(nursery) {
+            for (size_t i = 0; i < N; ++i) {
+                nursery.start([i]() -> Task<void> {
+                    co_await qSleepFor(std::chrono::seconds(60 + i % 3600));
+                });
+            }
+            co_await corral::yield;
+            co_return corral::cancel;
+        };
+        m.stop();
+    }
+
+    if (filter.matches("qt.sleepJitter")) {
+        // Achieved vs requested delay: ns_per_op is the mean time
+        // a qSleepForNs() actually took, the ".max" line the worst one.
+        struct Case {
+            const char* name;
+            const char* maxName;
+            std::chrono::nanoseconds delay;
+        };
+        static constexpr Case Cases[] = {
+                {"qt.sleepJitter.50us", "qt.sleepJitter.50us.max", 50us},
+                {"qt.sleepJitter.250us", "qt.sleepJitter.250us.max", 250us},
+                {"qt.sleepJitter.1ms", "qt.sleepJitter.1ms.max", 1ms},
+                {"qt.sleepJitter.5ms", "qt.sleepJitter.5ms.max", 5ms},
+        };
+        constexpr size_t N = 200;
+        for (const Case& c : Cases) {
+            std::chrono::nanoseconds worst{0};
+            Measurement m(c.name, N);
+            for (size_t i = 0; i < N; ++i) {
+                auto start = std::chrono::steady_clock::now();
+                co_await qSleepForNs(c.delay.count());
+                auto took = std::chrono::steady_clock::now() - start;
+                worst = std::max<std::chrono::nanoseconds>(worst, took);
+            }
+            m.stop();
+            report(c.maxName, 1, worst, 0);
+        }
+    }
+
+    if (filter.matches("qt.awaitTimeout")) {
+        constexpr size_t N = 20000;
+        Measurement m("qt.awaitTimeout", N);
+        for (size_t i = 0; i < N; ++i) {
+            co_await qAwaitTimeout(1h, corral::just<int>(1));
+        }
+        m.stop();
+    }
+}
+
+//
+// CorralQIODevice over an in-memory QBuffer
+//
+
+CorralQIODevice openBuffer(const QByteArray& data) {
+    auto* buffer = new QBuffer;
+    buffer->setData(data);
+    return CorralQIODevice::open(buffer, "bench", QIODevice::ReadOnly);
+}
+
+Task<void> benchQIODevice(Filter filter) {
+    if (filter.matches("qiodevice.read64")) {
+        constexpr size_t N = 100000;
+        constexpr size_t ChunkSize = 64;
+        CorralQIODevice device = openBuffer(QByteArray(N * ChunkSize, 'x'));
+        Measurement m("qiodevice.read64", N);
+        for (size_t i = 0; i < N; ++i) {
+            co_await device.read(ChunkSize);
+        }
+        m.stop();
+    }
+
+    if (filter.matches("qiodevice.readLines")) {
+        constexpr size_t N = 100000;
+        QByteArray data;
+        for (size_t i = 0; i < N; ++i) {
+            data += "line " + QByteArray::number(qulonglong(i)) + "\r\n";
+        }
+        CorralQIODevice device = openBuffer(data);
+        size_t lines = 0;
+        Measurement m("qiodevice.readLines", N);
+        co_await device.readLines([&lines](QString) { return ++lines == N; });
+        m.stop();
+    }
+}
+
+} // namespace
+
+Task<void> runQtBenches(Filter filter) {
+    // Make sure the event loop is actually running before we measure
+    // anything (and before the caller gets to quit it).
+    co_await qSleepForNs(1);
+
+    co_await benchTimers(filter);
+    co_await benchQIODevice(filter);
+}
+
+} // namespace corral_bench
@@ -0,0 +1,65 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include <QCoreApplication>
+
+#include "bench.h"
+#include "corral/qt/corralqt.h"
+
+namespace {
+std::atomic<size_t> g_allocations{0};
+}
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace corral_bench {
+
+size_t allocationCount() noexcept {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+void report(std::string_view name,
+            size_t iterations,
+            std::chrono::nanoseconds elapsed,
+            size_t allocations) {
+    double n = iterations ? static_cast<double>(iterations) : 1.0;
+    std::printf("{\"bench\":\"%.*s\",\"iterations\":%zu,"
+                "\"ns_per_op\":%.2f,\"allocs_per_op\":%.3f}\n",
+                static_cast<int>(name.size()), name.data(), iterations,
+                static_cast<double>(elapsed.count()) / n,
+                static_cast<double>(allocations) / n);
+    std::fflush(stdout);
+}
+
+} // namespace corral_bench
+
+/// Usage: corral_bench [pattern]
+///
+/// Runs every benchmark whose name contains `pattern` (all of them if
+/// omitted). Core benchmarks run first on a trivial event loop; the ones
+/// exercising the Qt layer run afterwards inside a QCoreApplication.
+int main(int argc, char** argv) {
+    std::string pattern = argc > 1 ? argv[1] : "";
+    corral_bench::Filter filter{pattern};
+
+    corral_bench::runCoreBenches(filter);
+
+    QCoreApplication app(argc, argv);
+    CorralQt::run([filter]() -> corral::Task<void> {
+        co_await corral_bench::runQtBenches(filter);
+        QCoreApplication::quit();
+    });
+    CorralQt::exec(app);
+    return 0;
+}
@@ -0,0 +1,466 @@
+// This file is part of corral, a lightweight C++20 coroutine library.
+//
+// Copyright (c) 2024 Hudson River Trading LLC <opensource@hudson-trading.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// SPDX-License-Identifier: MIT
+
+
+#pragma once
+#include <stdint.h>
+
+#include <type_traits>
+#include <utility>
+
+#include "config.h"
+#include "detail/ParkingLot.h"
+
+namespace corral {
+
+/// A mutual exclusion lock for tasks.
+///
+/// Unlike a Semaphore(1), an AsyncMutex hands ownership over directly
+/// when unlocked with tasks waiting: the first of them (in FIFO order)
+/// becomes the owner right away, so no other task can barge in before
+/// it gets to run. Locking and unlocking an uncontended mutex only
+/// tests and flips a flag, without touching the list of waiters.
+///
+///    corral::AsyncMutex mutex;
+///    auto lk = co_await mutex.lock();
+///    co_await device.write(request);
+///    auto response = co_await device.read();
+class AsyncMutex : public detail::ParkingLotImpl<AsyncMutex> {
+  public:
+    template <class Retval> class Awaitable;
+    class Lock;
+
+    AsyncMutex() = default;
+
+    bool locked() const noexcept { return locked_; }
+
+    /// An awaitable that locks the mutex, suspending the caller
+    /// until it is available.
+    [[nodiscard]] corral::Awaitable<void> auto acquire();
+
+    /// Locks the mutex if it is available; returns false otherwise.
+    bool tryAcquire() noexcept;
+
+    /// Unlocks the mutex, handing it over to the first suspended
+    /// task (if any).
+    void release();
+
+    /// RAII-style locking, returning a guard object which will
+    /// unlock the mutex upon going out of scope.
+    [[nodiscard]] corral::Awaitable<Lock> auto lock();
+
+    /// Same as above, but returns an empty guard instead of suspending
+    /// if the mutex is locked.
+    Lock tryLock() noexcept;
+
+  private:
+    bool locked_ = false;
+};
+
+
+/// A reader-writer lock for tasks: any number of tasks can hold it
+/// shared, or a single task exclusively.
+///
+/// As with AsyncMutex, ownership is handed over directly to waiting
+/// tasks upon unlocking, and uncontended locking does not touch
+/// the lists of waiters. Once a task is waiting for exclusive
+/// ownership, tasks asking for shared ownership queue up behind it
+/// rather than joining the current holders, so writers do not starve.
+/// Who goes next once the lock becomes free is decided by Fairness.
+class AsyncSharedMutex : public detail::ParkingLotImpl<AsyncSharedMutex> {
+    class Readers;
+    template <class Lot> class Waiter;
+    template <class Retval> class ExclusiveAwaitable;
+    template <class Retval> class SharedAwaitable;
+
+  public:
+    class Lock;
+    class SharedLock;
+
+    enum class Fairness {
+        /// Waiters get the lock in the order they asked for it,
+        /// consecutive shared waiters together.
+        Fifo,
+
+        /// Tasks waiting for exclusive ownership go before all tasks
+        /// waiting for shared ownership.
+        WriterPreferring,
+    };
+
+    explicit AsyncSharedMutex(Fairness fairness = Fairness::Fifo);
+
+    /// Returns true if the lock is held exclusively.
+    bool locked() const noexcept { return writer_; }
+
+    /// Returns the number of tasks holding the lock shared.
+    size_t sharedCount() const noexcept { return shared_; }
+
+    /// Exclusive ownership, with the same interface as AsyncMutex.
+    [[nodiscard]] corral::Awaitable<void> auto acquire();
+    bool tryAcquire() noexcept;
+    void release();
+    [[nodiscard]] corral::Awaitable<Lock> auto lock();
+    Lock tryLock() noexcept;
+
+    /// Shared ownership.
+    [[nodiscard]] corral::Awaitable<void> auto acquireShared();
+    bool tryAcquireShared() noexcept;
+    void releaseShared();
+    [[nodiscard]] corral::Awaitable<SharedLock> auto lockShared();
+    SharedLock tryLockShared() noexcept;
+
+  private:
+    /// Tasks waiting for shared ownership; the ones waiting for
+    /// exclusive ownership are parked in the mutex itself.
+    class Readers : public detail::ParkingLotImpl<Readers> {
+      public:
+        explicit Readers(AsyncSharedMutex& mutex) : mutex_(mutex) {}
+        AsyncSharedMutex& mutex() { return mutex_; }
+
+      private:
+        AsyncSharedMutex& mutex_;
+        friend class AsyncSharedMutex;
+    };
+
+    bool canLock() const noexcept;
+    bool canLockShared() const noexcept;
+
+    /// Hands the lock over to whoever is next in line, as long as
+    /// it is free for them.
+    void dispatch();
+
+  private:
+    Fairness fairness_;
+    bool writer_ = false;
+    size_t shared_ = 0;
+    uint64_t nextTicket_ = 0;
+    Readers readers_;
+};
+
+
+//
+// Implementation
+//
+
+class [[nodiscard]] AsyncMutex::Lock {
+  public:
+    Lock() = default;
+    Lock(Lock&& lk) noexcept : mutex_(std::exchange(lk.mutex_, nullptr)) {}
+    Lock& operator=(Lock lk) noexcept {
+        std::swap(mutex_, lk.mutex_);
+        return *this;
+    }
+    ~Lock() {
+        if (mutex_) {
+            mutex_->release();
+        }
+    }
+
+    explicit operator bool() const noexcept { return mutex_ != nullptr; }
+
+  private:
+    explicit Lock(AsyncMutex& mutex) : mutex_(&mutex) {}
+    friend class AsyncMutex;
+
+  private:
+    AsyncMutex* mutex_ = nullptr;
+};
+
+template <class Retval>
+class AsyncMutex::Awaitable
+  : public detail::ParkingLotImpl<AsyncMutex>::Parked {
+  public:
+    using Parked::Parked;
+    bool await_ready() const noexcept { return !this->object().locked_; }
+
+    void await_suspend(Handle h) { this->doSuspend(h); }
+
+    auto await_resume() {
+        // If we have been suspended, release() has kept the mutex
+        // locked on our behalf.
+        this->object().locked_ = true;
+        if constexpr (!std::is_same_v<Retval, void>) {
+            return Retval(this->object());
+        }
+    }
+};
+
+inline corral::Awaitable<void> auto AsyncMutex::acquire() {
+    return Awaitable<void>(*this);
+}
+
+inline bool AsyncMutex::tryAcquire() noexcept {
+    return !std::exchange(locked_, true);
+}
+
+inline void AsyncMutex::release() {
+    CORRAL_ASSERT(locked_);
+    if (!empty()) {
+        unparkOne();
+    } else {
+        locked_ = false;
+    }
+}
+
+inline corral::Awaitable<AsyncMutex::Lock> auto AsyncMutex::lock() {
+    return Awaitable<Lock>(*this);
+}
+
+inline AsyncMutex::Lock AsyncMutex::tryLock() noexcept {
+    return tryAcquire() ? Lock(*this) : Lock();
+}
+
+
+class [[nodiscard]] AsyncSharedMutex::Lock {
+  public:
+    Lock() = default;
+    Lock(Lock&& lk) noexcept : mutex_(std::exchange(lk.mutex_, nullptr)) {}
+    Lock& operator=(Lock lk) noexcept {
+        std::swap(mutex_, lk.mutex_);
+        return *this;
+    }
+    ~Lock() {
+        if (mutex_) {
+            mutex_->release();
+        }
+    }
+
+    explicit operator bool() const noexcept { return mutex_ != nullptr; }
+
+  private:
+    explicit Lock(AsyncSharedMutex& mutex) : mutex_(&mutex) {}
+    friend class AsyncSharedMutex;
+
+  private:
+    AsyncSharedMutex* mutex_ = nullptr;
+};
+
+class [[nodiscard]] AsyncSharedMutex::SharedLock {
+  public:
+    SharedLock() = default;
+    SharedLock(SharedLock&& lk) noexcept
+      : mutex_(std::exchange(lk.mutex_, nullptr)) {}
+    SharedLock& operator=(SharedLock lk) noexcept {
+        std::swap(mutex_, lk.mutex_);
+        return *this;
+    }
+    ~SharedLock() {
+        if (mutex_) {
+            mutex_->releaseShared();
+        }
+    }
+
+    explicit operator bool() const noexcept { return mutex_ != nullptr; }
+
+  private:
+    explicit SharedLock(AsyncSharedMutex& mutex) : mutex_(&mutex) {}
+    friend class AsyncSharedMutex;
+
+  private:
+    AsyncSharedMutex* mutex_ = nullptr;
+};
+
+/// Common part of exclusive and shared waiters, parked in `Lot`.
+/// dispatch() tells them apart by their tickets, which record
+/// the order they started waiting in.
+template <class Lot>
+class AsyncSharedMutex::Waiter : public detail::ParkingLotImpl<Lot>::Parked {
+    using Base = typename detail::ParkingLotImpl<Lot>::Parked;
+
+  public:
+    using Base::Base;
+
+    void await_suspend(Handle h) {
+        ticket_ = mutex().nextTicket_++;
+        this->doSuspend(h);
+    }
+
+    auto await_cancel(Handle h) noexcept {
+        Base::await_cancel(h);
+        // Whoever was queued behind us may be able to go now
+        // (e.g. readers behind a cancelled writer).
+        mutex().dispatch();
+        return std::true_type{};
+    }
+
+  protected:
+    /// Set by dispatch(), which has already recorded us as an owner;
+    /// otherwise we have taken the fast path and need to do it.
+    bool granted_ = false;
+
+    AsyncSharedMutex& mutex() {
+        if constexpr (std::is_same_v<Lot, Readers>) {
+            return this->object().mutex();
+        } else {
+            return this->object();
+        }
+    }
+    const AsyncSharedMutex& mutex() const {
+        return const_cast<Waiter*>(this)->mutex();
+    }
+
+  private:
+    uint64_t ticket_ = 0;
+    friend class AsyncSharedMutex;
+};
+
+template <class Retval>
+class AsyncSharedMutex::ExclusiveAwaitable : public Waiter<AsyncSharedMutex> {
+  public:
+    using Waiter::Waiter;
+
+    bool await_ready() const noexcept { return this->mutex().canLock(); }
+
+    auto await_resume() {
+        if (!this->granted_) {
+            this->mutex().writer_ = true;
+        }
+        if constexpr (!std::is_same_v<Retval, void>) {
+            return Retval(this->mutex());
+        }
+    }
+};
+
+template <class Retval>
+class AsyncSharedMutex::SharedAwaitable : public Waiter<Readers> {
+  public:
+    using Waiter::Waiter;
+
+    bool await_ready() const noexcept {
+        return this->mutex().canLockShared();
+    }
+
+    auto await_resume() {
+        if (!this->granted_) {
+            ++this->mutex().shared_;
+        }
+        if constexpr (!std::is_same_v<Retval, void>) {
+            return Retval(this->mutex());
+        }
+    }
+};
+
+inline AsyncSharedMutex::AsyncSharedMutex(Fairness fairness)
+  : fairness_(fairness), readers_(*this) {}
+
+inline corral::Awaitable<void> auto AsyncSharedMutex::acquire() {
+    return ExclusiveAwaitable<void>(*this);
+}
+
+inline bool AsyncSharedMutex::canLock() const noexcept {
+    return !writer_ && !shared_ && empty() && readers_.empty();
+}
+
+inline bool AsyncSharedMutex::tryAcquire() noexcept {
+    if (!canLock()) {
+        return false;
+    }
+    writer_ = true;
+    return true;
+}
+
+inline void AsyncSharedMutex::release() {
+    CORRAL_ASSERT(writer_);
+    writer_ = false;
+    dispatch();
+}
+
+inline corral::Awaitable<AsyncSharedMutex::Lock> auto
+AsyncSharedMutex::lock() {
+    return ExclusiveAwaitable<Lock>(*this);
+}
+
+inline AsyncSharedMutex::Lock AsyncSharedMutex::tryLock() noexcept {
+    return tryAcquire() ? Lock(*this) : Lock();
+}
+
+inline corral::Awaitable<void> auto AsyncSharedMutex::acquireShared() {
+    return SharedAwaitable<void>(readers_);
+}
+
+inline bool AsyncSharedMutex::canLockShared() const noexcept {
+    // Do not overtake any waiters: writers would starve, and other
+    // readers are only waiting because a writer is ahead of them.
+    return !writer_ && empty() && readers_.empty();
+}
+
+inline bool AsyncSharedMutex::tryAcquireShared() noexcept {
+    if (!canLockShared()) {
+        return false;
+    }
+    ++shared_;
+    return true;
+}
+
+inline void AsyncSharedMutex::releaseShared() {
+    CORRAL_ASSERT(shared_ > 0);
+    // Readers only ever queue up behind a writer, so there is nobody
+    // to hand the lock over to unless a writer is waiting.
+    if (--shared_ == 0 && !empty()) {
+        dispatch();
+    }
+}
+
+inline corral::Awaitable<AsyncSharedMutex::SharedLock> auto
+AsyncSharedMutex::lockShared() {
+    return SharedAwaitable<SharedLock>(readers_);
+}
+
+inline AsyncSharedMutex::SharedLock AsyncSharedMutex::tryLockShared() noexcept {
+    return tryAcquireShared() ? SharedLock(*this) : SharedLock();
+}
+
+inline void AsyncSharedMutex::dispatch() {
+    using WriterWaiter = Waiter<AsyncSharedMutex>;
+    using ReaderWaiter = Waiter<Readers>;
+
+    // Waking a task only queues it to run later, so ownership is
+    // recorded here up front (in writer_/shared_, with granted_ telling
+    // the waiter not to take it again on resumption). That keeps the
+    // mutex from being grabbed by someone else in the meantime, and
+    // lets each iteration see the grants made by the previous ones:
+    // readers at the head are let in one after another, until a writer
+    // is reached.
+    while (!writer_) {
+        auto* w = static_cast<WriterWaiter*>(peek());
+        auto* r = static_cast<ReaderWaiter*>(readers_.peek());
+        if (w && (!r || fairness_ == Fairness::WriterPreferring ||
+                  w->ticket_ < r->ticket_)) {
+            if (shared_ == 0) {
+                writer_ = true;
+                w->granted_ = true;
+                unparkOne();
+            }
+            return;
+        }
+        if (!r) {
+            return;
+        }
+        ++shared_;
+        r->granted_ = true;
+        readers_.unparkOne();
+    }
+}
+
+} // namespace corral
@@ -0,0 +1,548 @@
+// This file is part of corral, a lightweight C++20 coroutine library.
+//
+// Copyright (c) 2024 Hudson River Trading LLC <opensource@hudson-trading.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// SPDX-License-Identifier: MIT
+
+
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "concepts.h"
+#include "config.h"
+#include "defs.h"
+#include "detail/IntrusiveList.h"
+
+namespace corral {
+
+/// What a BroadcastChannel does when its buffer is full, i.e., when
+/// its slowest subscriber lags `capacity` objects behind.
+enum class SlowSubscriberPolicy {
+    /// Senders wait until the slowest subscriber catches up.
+    Block,
+
+    /// The oldest object is discarded, and subscribers which have not
+    /// received it yet skip it (see Subscription::dropped()).
+    DropOldest,
+
+    /// The subscribers holding things up are disconnected: whatever
+    /// they have not received yet is discarded (that is what frees
+    /// the space), and they see the channel as closed right away
+    /// (see Subscription::disconnected()).
+    Disconnect,
+};
+
+/// A channel delivering every object sent to each of its subscribers.
+///
+/// Objects are stored once, in a ring buffer of fixed capacity shared
+/// by all subscribers, each of which has its own read cursor into it;
+/// an object is destroyed as soon as every subscriber has received it.
+/// So memory use does not depend on the number of subscribers, but a
+/// subscriber lagging behind keeps the others' objects around; what
+/// happens once the buffer is full is decided by SlowSubscriberPolicy.
+///
+/// Subscribers receive copies of the objects, except for the last one
+/// to receive a given object, which gets it moved out of the buffer.
+///
+///    corral::BroadcastChannel<Frame> frames(64,
+///            corral::SlowSubscriberPolicy::DropOldest);
+///    auto sub = frames.subscribe();
+///    while (std::optional<Frame> frame = co_await sub.receive()) {
+///        // ...
+///    }
+///
+/// A subscriber only sees objects sent after it has subscribed.
+template <class T> class BroadcastChannel {
+    class ReceiveAwaitable;
+    class SendAwaitableBase;
+    template <class U> class SendAwaitable;
+
+  public:
+    class Subscription;
+
+    /// Constructs a channel buffering up to `capacity` objects which
+    /// have not been received by every subscriber yet. Space for them
+    /// is allocated immediately, and no further allocations are made.
+    explicit BroadcastChannel(
+            size_t capacity,
+            SlowSubscriberPolicy policy = SlowSubscriberPolicy::Block);
+
+    /// Detect some uses of 'BroadcastChannel(0)' and fail at compile time.
+    explicit BroadcastChannel(std::nullptr_t) = delete;
+
+    BroadcastChannel(BroadcastChannel&&) = delete;
+    BroadcastChannel& operator=(BroadcastChannel&&) = delete;
+
+    /// Subscriptions still around lose their connection to the channel,
+    /// and see it as closed.
+    ~BroadcastChannel();
+
+    /// Returns a new subscription, which will receive every object
+    /// sent from now on.
+    Subscription subscribe() { return Subscription(*this); }
+
+    /// Returns the number of objects in the buffer, i.e., sent but not
+    /// received by every subscriber yet.
+    size_t size() const noexcept { return tail_ - head_; }
+    size_t capacity() const noexcept { return capacity_; }
+    size_t subscribers() const noexcept { return subscriberCount_; }
+    SlowSubscriberPolicy policy() const noexcept { return policy_; }
+
+    /// Returns true if trySend() would fail: because the channel is
+    /// closed, or because it is full and the policy is
+    /// SlowSubscriberPolicy::Block.
+    bool full() const noexcept {
+        return closed_ || (policy_ == SlowSubscriberPolicy::Block &&
+                           size() == capacity_);
+    }
+
+    /// Returns true if close() has been called on this channel.
+    bool closed() const noexcept { return closed_; }
+
+    /// Closes the channel. No more objects can be sent; subscribers
+    /// receive whatever is left in the buffer, then std::nullopt.
+    void close();
+
+    /// Delivers an object to every subscriber, waiting for the slowest
+    /// one to catch up if the buffer is full and the policy is
+    /// SlowSubscriberPolicy::Block (with other policies, this never
+    /// suspends). Returns false if the channel has been closed.
+    /// Waiting senders are served in FIFO order.
+    template <class U> Awaitable<bool> auto send(U&& value) {
+        return SendAwaitable<U>(*this, std::forward<U>(value));
+    }
+
+    /// Same as above, but returns false instead of waiting.
+    template <class U> bool trySend(U&& value);
+
+  private:
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        /// Number of subscribers which have not received this object yet.
+        size_t pending;
+
+        T* object() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    Slot& slot(size_t seq) { return slots_[seq & mask_]; }
+
+    /// Stores an object; there must be space for it.
+    template <class U> void push(U&& value);
+
+    /// Makes space for an object according to policy_.
+    void makeSpace();
+
+    /// Destroys objects at the front of the buffer which every
+    /// subscriber has received, and hands the space freed to waiting
+    /// senders.
+    void trim();
+
+    void wakeReceivers();
+
+  private:
+    size_t capacity_;
+    size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    SlowSubscriberPolicy policy_;
+    bool closed_ = false;
+
+    /// Sequence numbers of the oldest object in the buffer,
+    /// and of the next one to be sent.
+    size_t head_ = 0;
+    size_t tail_ = 0;
+
+    detail::IntrusiveList<Subscription> subscriptions_;
+    size_t subscriberCount_ = 0;
+    detail::IntrusiveList<ReceiveAwaitable> receivers_;
+    detail::IntrusiveList<SendAwaitableBase> senders_;
+};
+
+
+/// A subscriber's cursor into a BroadcastChannel, obtained through
+/// BroadcastChannel::subscribe(). Unsubscribes when destroyed.
+template <class T>
+class BroadcastChannel<T>::Subscription
+  : public detail::IntrusiveListItem<Subscription> {
+  public:
+    Subscription(Subscription&& rhs) noexcept;
+    Subscription& operator=(Subscription&& rhs) noexcept;
+    ~Subscription() { reset(); }
+
+    /// Returns an object sent to the channel, waiting for one if there
+    /// is none yet. Returns std::nullopt if the channel is closed and
+    /// nothing is left for this subscription to receive, or after the
+    /// subscription has been disconnected.
+    Awaitable<std::optional<T>> auto receive() {
+        return ReceiveAwaitable(*this);
+    }
+
+    /// Same as above, but returns std::nullopt instead of waiting.
+    std::optional<T> tryReceive();
+
+    /// Returns the number of objects immediately available to receive.
+    size_t size() const noexcept;
+
+    /// Returns the number of objects this subscription missed so far
+    /// because of SlowSubscriberPolicy::DropOldest.
+    size_t dropped() const noexcept { return dropped_; }
+
+    /// Returns true if the subscription has been disconnected because of
+    /// SlowSubscriberPolicy::Disconnect.
+    bool disconnected() const noexcept { return disconnected_; }
+
+    /// Unsubscribes; further receives will return std::nullopt.
+    void reset();
+
+  private:
+    friend BroadcastChannel;
+    explicit Subscription(BroadcastChannel& channel);
+
+    /// Whether receive() would not need to wait.
+    bool ready() const noexcept;
+
+    /// Catches up with objects dropped by DropOldest.
+    void skipDropped() noexcept;
+
+    /// Leaves the channel, giving up anything not received yet.
+    void detach();
+
+  private:
+    BroadcastChannel* channel_ = nullptr;
+    size_t cursor_ = 0;
+    size_t dropped_ = 0;
+    bool disconnected_ = false;
+    bool receiving_ = false;
+};
+
+
+//
+// Implementation
+//
+
+template <class T>
+class BroadcastChannel<T>::ReceiveAwaitable
+  : public detail::IntrusiveListItem<ReceiveAwaitable> {
+  public:
+    explicit ReceiveAwaitable(Subscription& sub) : sub_(sub) {}
+
+    bool await_ready() const noexcept { return sub_.ready(); }
+    void await_suspend(Handle h) {
+        CORRAL_ASSERT(!sub_.receiving_ &&
+                      "only one receive() per subscription at a time");
+        handle_ = h;
+        sub_.receiving_ = true;
+        sub_.channel_->receivers_.push_back(*this);
+    }
+    std::optional<T> await_resume() { return sub_.tryReceive(); }
+    auto await_cancel(Handle) noexcept {
+        this->unlink();
+        sub_.receiving_ = false;
+        return std::true_type{};
+    }
+
+  private:
+    friend BroadcastChannel;
+
+    void wake() {
+        sub_.receiving_ = false;
+        handle_.resume();
+    }
+
+    Subscription& sub_;
+    Handle handle_;
+};
+
+template <class T>
+class BroadcastChannel<T>::SendAwaitableBase
+  : public detail::IntrusiveListItem<SendAwaitableBase> {
+  public:
+    explicit SendAwaitableBase(BroadcastChannel& channel)
+      : channel_(channel) {}
+
+    bool await_ready() const noexcept {
+        return !channel_.full() || channel_.closed();
+    }
+    void await_suspend(Handle h) {
+        handle_ = h;
+        channel_.senders_.push_back(*this);
+    }
+    auto await_cancel(Handle) noexcept {
+        this->unlink();
+        return std::true_type{};
+    }
+
+  protected:
+    /// Called upon a wakeup to push the object, if `space` is true;
+    /// the sender is then resumed.
+    virtual void deliver(bool space) = 0;
+
+    void wake(bool space) {
+        deliver(space);
+        handle_.resume();
+    }
+
+    BroadcastChannel& channel_;
+
+  private:
+    friend BroadcastChannel;
+    Handle handle_;
+};
+
+template <class T>
+template <class U>
+class BroadcastChannel<T>::SendAwaitable : public SendAwaitableBase {
+  public:
+    SendAwaitable(BroadcastChannel& channel, U&& value)
+      : SendAwaitableBase(channel), value_(std::forward<U>(value)) {}
+
+    bool await_resume() {
+        if (!resumed_) {
+            // Did not need to wait
+            return this->channel_.trySend(std::forward<U>(value_));
+        }
+        return sent_;
+    }
+
+  private:
+    void deliver(bool space) override {
+        resumed_ = true;
+        if (space) {
+            // Handed over directly, so nobody else can grab the space
+            // before this sender gets to run
+            this->channel_.push(std::forward<U>(value_));
+            sent_ = true;
+        }
+    }
+
+    U&& value_;
+    bool resumed_ = false;
+    bool sent_ = false;
+};
+
+
+template <class T>
+BroadcastChannel<T>::BroadcastChannel(size_t capacity,
+                                      SlowSubscriberPolicy policy)
+  : capacity_(capacity),
+    mask_(std::bit_ceil(capacity) - 1),
+    slots_(new Slot[mask_ + 1]),
+    policy_(policy) {
+    CORRAL_ASSERT(capacity > 0);
+}
+
+template <class T> BroadcastChannel<T>::~BroadcastChannel() {
+    CORRAL_ASSERT(receivers_.empty() && senders_.empty() &&
+                  "Still some tasks suspended on this channel");
+    while (!subscriptions_.empty()) {
+        subscriptions_.front().detach();
+    }
+    trim();
+}
+
+template <class T> void BroadcastChannel<T>::close() {
+    closed_ = true;
+    wakeReceivers();
+    auto senders = std::move(senders_);
+    while (!senders.empty()) {
+        SendAwaitableBase& s = senders.front();
+        senders.pop_front();
+        s.wake(/*space = */ false);
+    }
+}
+
+template <class T>
+template <class U>
+bool BroadcastChannel<T>::trySend(U&& value) {
+    if (full()) {
+        return false;
+    }
+    makeSpace();
+    push(std::forward<U>(value));
+    return true;
+}
+
+template <class T>
+template <class U>
+void BroadcastChannel<T>::push(U&& value) {
+    if (subscriberCount_ == 0) {
+        return; // nobody to deliver to
+    }
+    Slot& s = slot(tail_);
+    new (s.object()) T(std::forward<U>(value));
+    s.pending = subscriberCount_;
+    ++tail_;
+    wakeReceivers();
+}
+
+template <class T> void BroadcastChannel<T>::makeSpace() {
+    if (size() < capacity_) {
+        return;
+    }
+    if (policy_ == SlowSubscriberPolicy::DropOldest) {
+        // Subscriptions still expecting it notice in skipDropped()
+        slot(head_).object()->~T();
+        ++head_;
+    } else if (policy_ == SlowSubscriberPolicy::Disconnect) {
+        // Nobody disconnected here can be waiting in receive(),
+        // since they all have something left to receive.
+        for (auto it = subscriptions_.begin(); it != subscriptions_.end();) {
+            Subscription& sub = *it++;
+            sub.skipDropped();
+            if (sub.cursor_ == head_) {
+                sub.disconnected_ = true;
+                sub.detach();
+            }
+        }
+        trim();
+    }
+}
+
+template <class T> void BroadcastChannel<T>::trim() {
+    bool freed = false;
+    while (head_ != tail_ && slot(head_).pending == 0) {
+        slot(head_).object()->~T();
+        ++head_;
+        freed = true;
+    }
+    // Hand the space over; each wakeup may re-enter here
+    // (through the sender's task), so re-check every time.
+    while (freed && !senders_.empty() && size() < capacity_) {
+        SendAwaitableBase& s = senders_.front();
+        senders_.pop_front();
+        s.wake(/*space = */ true);
+    }
+}
+
+template <class T> void BroadcastChannel<T>::wakeReceivers() {
+    auto receivers = std::move(receivers_);
+    while (!receivers.empty()) {
+        ReceiveAwaitable& r = receivers.front();
+        receivers.pop_front();
+        r.wake();
+    }
+}
+
+
+template <class T>
+BroadcastChannel<T>::Subscription::Subscription(BroadcastChannel& channel)
+  : channel_(&channel), cursor_(channel.tail_) {
+    channel.subscriptions_.push_back(*this);
+    ++channel.subscriberCount_;
+}
+
+template <class T>
+BroadcastChannel<T>::Subscription::Subscription(Subscription&& rhs) noexcept
+  : channel_(std::exchange(rhs.channel_, nullptr)),
+    cursor_(rhs.cursor_),
+    dropped_(rhs.dropped_),
+    disconnected_(rhs.disconnected_) {
+    CORRAL_ASSERT(!rhs.receiving_ && "cannot move a subscription in use");
+    if (channel_) {
+        channel_->subscriptions_.push_back(*this);
+        rhs.unlink();
+    }
+}
+
+template <class T>
+auto BroadcastChannel<T>::Subscription::operator=(Subscription&& rhs) noexcept
+        -> Subscription& {
+    if (this != &rhs) {
+        reset();
+        CORRAL_ASSERT(!rhs.receiving_ && "cannot move a subscription in use");
+        channel_ = std::exchange(rhs.channel_, nullptr);
+        cursor_ = rhs.cursor_;
+        dropped_ = rhs.dropped_;
+        disconnected_ = rhs.disconnected_;
+        if (channel_) {
+            channel_->subscriptions_.push_back(*this);
+            rhs.unlink();
+        }
+    }
+    return *this;
+}
+
+template <class T> void BroadcastChannel<T>::Subscription::reset() {
+    CORRAL_ASSERT(!receiving_ && "cannot unsubscribe while receiving");
+    if (channel_) {
+        BroadcastChannel& ch = *channel_;
+        detach();
+        ch.trim();
+    }
+}
+
+template <class T> void BroadcastChannel<T>::Subscription::detach() {
+    skipDropped();
+    for (size_t seq = cursor_; seq != channel_->tail_; ++seq) {
+        --channel_->slot(seq).pending;
+    }
+    this->unlink();
+    --channel_->subscriberCount_;
+    channel_ = nullptr;
+}
+
+template <class T>
+void BroadcastChannel<T>::Subscription::skipDropped() noexcept {
+    if (cursor_ < channel_->head_) {
+        dropped_ += channel_->head_ - cursor_;
+        cursor_ = channel_->head_;
+    }
+}
+
+template <class T>
+size_t BroadcastChannel<T>::Subscription::size() const noexcept {
+    if (!channel_) {
+        return 0;
+    }
+    return channel_->tail_ - std::max(cursor_, channel_->head_);
+}
+
+template <class T>
+bool BroadcastChannel<T>::Subscription::ready() const noexcept {
+    return !channel_ || channel_->closed_ || size() > 0;
+}
+
+template <class T>
+std::optional<T> BroadcastChannel<T>::Subscription::tryReceive() {
+    std::optional<T> ret;
+    if (!channel_) {
+        return ret;
+    }
+    skipDropped();
+    if (cursor_ == channel_->tail_) {
+        return ret;
+    }
+    Slot& s = channel_->slot(cursor_++);
+    if (--s.pending == 0) {
+        ret.emplace(std::move(*s.object()));
+        channel_->trim();
+    } else {
+        ret.emplace(*s.object());
+    }
+    return ret;
+}
+
+} // namespace corral
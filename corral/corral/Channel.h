@@ -24,7 +24,11 @@
 
 #pragma once
 
+#include <iterator>
+#include <limits>
 #include <optional>
+#include <ranges>
+#include <span>
 
 #include "config.h"
 #include "detail/ParkingLot.h"
@@ -34,10 +38,29 @@ namespace corral {
 
 template <typename T> struct Channel;
 
+/// What a bounded Channel does with an object sent while it is full.
+enum class ChannelOverflow {
+    /// The sender waits for space (trySend() fails).
+    Block,
+
+    /// The oldest object in the channel is discarded to make room.
+    DropOldest,
+
+    /// The object being sent is discarded.
+    DropNewest,
+
+    /// The channel only keeps the latest object sent: each one replaces
+    /// the one before, if it has not been received yet. Requires
+    /// a channel of size 1.
+    Conflate,
+};
+
 namespace detail::channel {
 
 template <typename T> struct ReadHalf;
 template <typename T> struct WriteHalf;
+template <typename T> class SendSlot;
+template <typename T> class ReceiveSlot;
 
 /// Interface for reading from a Channel. Exposed publicly as
 /// Channel<T>::ReadHalf. See Channel for documentation.
@@ -45,6 +68,8 @@ template <typename T>
 class ReadHalf : public corral::detail::ParkingLotImpl<ReadHalf<T>> {
     friend Channel<T>;
     friend WriteHalf<T>;
+    friend SendSlot<T>;
+    friend ReceiveSlot<T>;
 
   private:
     Channel<T>& channel() { return static_cast<Channel<T>&>(*this); }
@@ -52,10 +77,13 @@ class ReadHalf : public corral::detail::ParkingLotImpl<ReadHalf<T>> {
         return static_cast<const Channel<T>&>(*this);
     }
 
-    struct ReadAwaitable : public ReadHalf::ParkingLotImpl::Parked {
+    /// A reader waiting for `want` objects (or for at least one of them,
+    /// for receiveMany()).
+    class Waiter : public ReadHalf::ParkingLotImpl::Parked {
         using Base = typename ReadHalf::ParkingLotImpl::Parked;
 
-        explicit ReadAwaitable(ReadHalf& self) : Base(self) {}
+      public:
+        Waiter(ReadHalf& self, size_t want) : Base(self), want_(want) {}
 
         bool await_ready() const noexcept {
             return !channel().empty() || channel().closed();
@@ -66,19 +94,78 @@ class ReadHalf : public corral::detail::ParkingLotImpl<ReadHalf<T>> {
             this->doSuspend(h);
         }
 
-        std::optional<T> await_resume() { return channel().tryReceive(); }
-
         using Base::await_cancel;
 
-      private:
+      protected:
+        friend ReadHalf;
+
         Channel<T>& channel() {
             return static_cast<Channel<T>&>(Base::object());
         }
         const Channel<T>& channel() const {
             return static_cast<const Channel<T>&>(Base::object());
         }
+
+        /// Called upon resumption, before taking anything
+        /// out of the channel.
+        void claim() {
+            channel().readHalf().granted_ -= granted_;
+            granted_ = 0;
+        }
+
+        size_t want_;
+        size_t granted_ = 0;
+    };
+
+    struct ReadAwaitable : public Waiter {
+        explicit ReadAwaitable(ReadHalf& self) : Waiter(self, 1) {}
+
+        std::optional<T> await_resume() {
+            this->claim();
+            return this->channel().tryReceive();
+        }
     };
 
+    struct PeekAwaitable : public Waiter {
+        explicit PeekAwaitable(ReadHalf& self) : Waiter(self, 1) {}
+
+        ReceiveSlot<T> await_resume() {
+            this->claim();
+            return this->channel().tryPeek();
+        }
+    };
+
+    struct ReadManyAwaitable : public Waiter {
+        ReadManyAwaitable(ReadHalf& self, std::span<T> out)
+          : Waiter(self, out.size()), out_(out) {}
+
+        bool await_ready() const noexcept {
+            return out_.empty() || Waiter::await_ready();
+        }
+
+        size_t await_resume() {
+            this->claim();
+            return this->channel().tryReceiveMany(out_);
+        }
+
+      private:
+        std::span<T> out_;
+    };
+
+    /// Wakes as many waiting readers as there are objects for, taking
+    /// into account the ones woken already but not yet resumed.
+    void wake() {
+        while (ReadHalf::ParkingLotImpl::peek() &&
+               channel().size() > granted_) {
+            auto& waiter =
+                    static_cast<Waiter&>(*ReadHalf::ParkingLotImpl::peek());
+            waiter.granted_ =
+                    std::min(channel().size() - granted_, waiter.want_);
+            granted_ += waiter.granted_;
+            this->unparkOne();
+        }
+    }
+
   public:
     corral::Awaitable<std::optional<T>> auto receive() {
         return ReadAwaitable(*this);
@@ -88,11 +175,48 @@ class ReadHalf : public corral::detail::ParkingLotImpl<ReadHalf<T>> {
         if (!channel().empty()) {
             data.emplace(std::move(channel().buf_.front()));
             channel().buf_.pop_front();
-            this->channel().writeHalf().unparkOne();
+            this->channel().writeHalf().wake();
         }
         return data;
     }
 
+    corral::Awaitable<size_t> auto receiveMany(std::span<T> out) {
+        return ReadManyAwaitable(*this, out);
+    }
+    size_t tryReceiveMany(std::span<T> out) {
+        size_t n = std::min(out.size(), channel().size());
+        channel().buf_.pop_front_n(n, out.begin());
+        if (n) {
+            channel().writeHalf().wake();
+        }
+        return n;
+    }
+    template <std::output_iterator<T> OutIt> OutIt drain(OutIt out) {
+        size_t n = channel().size();
+        out = channel().buf_.pop_front_n(n, std::move(out));
+        if (n) {
+            channel().writeHalf().wake();
+        }
+        return out;
+    }
+
+    corral::Awaitable<ReceiveSlot<T>> auto peek() {
+        return PeekAwaitable(*this);
+    }
+    ReceiveSlot<T> tryPeek() {
+        CORRAL_ASSERT(channel().bounded_ &&
+                      "peek() needs a bounded channel, whose storage "
+                      "never moves");
+        CORRAL_ASSERT(channel().overflow_ == ChannelOverflow::Block &&
+                      "peek() needs ChannelOverflow::Block, so that "
+                      "the object cannot be dropped meanwhile");
+        if (channel().empty()) {
+            return {};
+        }
+        channel().peeked_ = true;
+        return ReceiveSlot<T>(channel());
+    }
+
     size_t size() const noexcept { return channel().size(); }
     bool empty() const noexcept { return channel().empty(); }
     bool closed() const noexcept { return channel().closed(); }
@@ -106,6 +230,11 @@ class ReadHalf : public corral::detail::ParkingLotImpl<ReadHalf<T>> {
     bool hasWaiters() const noexcept {
         return !this->template ParkingLotImpl<ReadHalf<T>>::empty();
     }
+
+  private:
+    /// Objects promised to readers woken up but not resumed yet, so that
+    /// a receiveMany() resuming first does not leave them empty-handed.
+    size_t granted_ = 0;
 };
 
 /// Interface for writing to a Channel. Exposed publicly as
@@ -114,6 +243,8 @@ template <typename T>
 class WriteHalf : public corral::detail::ParkingLotImpl<WriteHalf<T>> {
     friend Channel<T>;
     friend ReadHalf<T>;
+    friend SendSlot<T>;
+    friend ReceiveSlot<T>;
 
   private:
     Channel<T>& channel() { return static_cast<Channel<T>&>(*this); }
@@ -121,12 +252,13 @@ class WriteHalf : public corral::detail::ParkingLotImpl<WriteHalf<T>> {
         return static_cast<const Channel<T>&>(*this);
     }
 
-    template <typename U>
-    struct WriteAwaitable : public WriteHalf::ParkingLotImpl::Parked {
+    /// A writer waiting for space for `want` objects (or for at least
+    /// one of them, for sendMany()).
+    class Waiter : public WriteHalf::ParkingLotImpl::Parked {
         using Base = typename WriteHalf::ParkingLotImpl::Parked;
 
-        WriteAwaitable(WriteHalf& self, U&& data)
-          : Base(self), data_(std::forward<U>(data)) {}
+      public:
+        Waiter(WriteHalf& self, size_t want) : Base(self), want_(want) {}
 
         bool await_ready() const noexcept {
             return channel().closed() || !channel().full();
@@ -137,13 +269,11 @@ class WriteHalf : public corral::detail::ParkingLotImpl<WriteHalf<T>> {
             this->doSuspend(h);
         }
 
-        bool await_resume() {
-            return channel().trySend(std::forward<U>(data_));
-        }
-
         using Base::await_cancel;
 
-      private:
+      protected:
+        friend WriteHalf;
+
         Channel<T>& channel() {
             return static_cast<Channel<T>&>(Base::object());
         }
@@ -151,9 +281,74 @@ class WriteHalf : public corral::detail::ParkingLotImpl<WriteHalf<T>> {
             return static_cast<const Channel<T>&>(Base::object());
         }
 
+        /// Called upon resumption, before putting anything
+        /// into the channel.
+        void claim() {
+            channel().writeHalf().granted_ -= granted_;
+            granted_ = 0;
+        }
+
+        size_t want_;
+        size_t granted_ = 0;
+    };
+
+    template <typename U> struct WriteAwaitable : public Waiter {
+        WriteAwaitable(WriteHalf& self, U&& data)
+          : Waiter(self, 1), data_(std::forward<U>(data)) {}
+
+        bool await_resume() {
+            this->claim();
+            return this->channel().trySend(std::forward<U>(data_));
+        }
+
+      private:
         U&& data_;
     };
 
+    struct ReserveAwaitable : public Waiter {
+        explicit ReserveAwaitable(WriteHalf& self) : Waiter(self, 1) {}
+
+        SendSlot<T> await_resume() {
+            this->claim();
+            return this->channel().tryReserve();
+        }
+    };
+
+    template <typename Range> struct WriteManyAwaitable : public Waiter {
+        WriteManyAwaitable(WriteHalf& self, Range&& range)
+          : Waiter(self, std::numeric_limits<size_t>::max()),
+            range_(std::forward<Range>(range)) {}
+
+        bool await_ready() const noexcept {
+            if constexpr (requires { std::ranges::empty(range_); }) {
+                if (std::ranges::empty(range_)) {
+                    return true;
+                }
+            }
+            return Waiter::await_ready();
+        }
+
+        size_t await_resume() {
+            this->claim();
+            return this->channel().trySendMany(std::forward<Range>(range_));
+        }
+
+      private:
+        Range&& range_;
+    };
+
+    /// Wakes as many waiting writers as there is space for, taking
+    /// into account the ones woken already but not yet resumed.
+    void wake() {
+        while (this->peek() && channel().space() > granted_) {
+            auto& waiter = static_cast<Waiter&>(*this->peek());
+            waiter.granted_ =
+                    std::min(channel().space() - granted_, waiter.want_);
+            granted_ += waiter.granted_;
+            this->unparkOne();
+        }
+    }
+
   public:
     template <typename U> corral::Awaitable<bool> auto send(U&& value) {
         return WriteAwaitable<U>(*this, std::forward<U>(value));
@@ -161,16 +356,66 @@ class WriteHalf : public corral::detail::ParkingLotImpl<WriteHalf<T>> {
     template <typename U> bool trySend(U&& value) {
         if (channel().closed() || channel().full()) {
             return false;
-        } else {
+        } else if (channel().makeRoom()) {
             channel().buf_.push_back(std::forward<U>(value));
-            channel().readHalf().unparkOne();
-            return true;
+            channel().readHalf().wake();
+        }
+        return true;
+    }
+
+    template <std::ranges::input_range Range>
+    corral::Awaitable<size_t> auto sendMany(Range&& range) {
+        return WriteManyAwaitable<Range>(*this, std::forward<Range>(range));
+    }
+    template <std::ranges::input_range Range>
+    size_t trySendMany(Range&& range) {
+        if (channel().overflow_ != ChannelOverflow::Block) {
+            // Everything goes in, one way or another
+            size_t n = 0;
+            for (auto&& value : range) {
+                n += trySend(std::forward<decltype(value)>(value));
+            }
+            return n;
+        }
+        size_t room = channel().space();
+        size_t n = 0;
+        if constexpr (std::ranges::forward_range<Range> &&
+                      std::ranges::sized_range<Range>) {
+            n = std::min<size_t>(room, std::ranges::size(range));
+            channel().buf_.push_back_n(std::ranges::begin(range), n);
+        } else {
+            auto it = std::ranges::begin(range);
+            auto end = std::ranges::end(range);
+            for (; n < room && it != end; ++it, ++n) {
+                channel().buf_.push_back(*it);
+            }
+        }
+        if (n) {
+            channel().readHalf().wake();
+        }
+        return n;
+    }
+
+    corral::Awaitable<SendSlot<T>> auto reserve() {
+        return ReserveAwaitable(*this);
+    }
+    SendSlot<T> tryReserve() {
+        CORRAL_ASSERT(channel().bounded_ &&
+                      "reserve() needs a bounded channel, whose storage "
+                      "never moves");
+        CORRAL_ASSERT(channel().overflow_ == ChannelOverflow::Block &&
+                      "reserve() needs ChannelOverflow::Block");
+        if (channel().full()) {
+            return {};
         }
+        channel().reserved_ = true;
+        return SendSlot<T>(channel());
     }
     void close() { channel().close(); }
 
     size_t space() const noexcept { return channel().space(); }
     bool full() const noexcept { return channel().full(); }
+    size_t dropped() const noexcept { return channel().dropped(); }
     bool closed() const noexcept { return channel().closed(); }
 
   protected:
@@ -182,6 +427,143 @@ class WriteHalf : public corral::detail::ParkingLotImpl<WriteHalf<T>> {
     bool hasWaiters() const noexcept {
         return !this->template ParkingLotImpl<WriteHalf<T>>::empty();
     }
+
+  private:
+    /// Space promised to writers woken up but not resumed yet.
+    size_t granted_ = 0;
+};
+
+/// A slot in a bounded Channel reserved for the object to be sent next,
+/// returned by Channel::reserve(). The object is constructed right in
+/// the channel's buffer with emplace(), can then be filled in through
+/// the slot, and is handed to readers by commit().
+///
+/// Only one slot can be reserved at a time; until it is committed
+/// or dropped (which discards the object, if any), the channel is full
+/// for everybody else.
+template <typename T> class SendSlot {
+  public:
+    /// An empty slot, as returned by tryReserve() if the channel is full.
+    SendSlot() = default;
+
+    SendSlot(SendSlot&& rhs) noexcept
+      : channel_(std::exchange(rhs.channel_, nullptr)) {}
+    SendSlot& operator=(SendSlot rhs) noexcept {
+        std::swap(channel_, rhs.channel_);
+        return *this;
+    }
+    ~SendSlot() { reset(); }
+
+    /// Returns false if the slot is empty, i.e., the reservation failed
+    /// because the channel was full or closed, or the slot has already
+    /// been committed or reset.
+    explicit operator bool() const noexcept { return channel_ != nullptr; }
+
+    /// Constructs the object in place, and returns a reference to it.
+    template <typename... Args> T& emplace(Args&&... args) {
+        CORRAL_ASSERT(channel_ && !channel_->unpublished_);
+        channel_->buf_.emplace_back(std::forward<Args>(args)...);
+        channel_->unpublished_ = 1;
+        return channel_->buf_.back();
+    }
+
+    T& operator*() const noexcept {
+        CORRAL_ASSERT(channel_ && channel_->unpublished_);
+        return channel_->buf_.back();
+    }
+    T* operator->() const noexcept { return &**this; }
+
+    /// Delivers the object constructed by emplace() to the channel.
+    /// Returns false (destroying the object) if the channel has been
+    /// closed in the meantime.
+    bool commit() {
+        CORRAL_ASSERT(channel_ && channel_->unpublished_ &&
+                      "nothing to commit");
+        Channel<T>& ch = *std::exchange(channel_, nullptr);
+        ch.reserved_ = false;
+        ch.unpublished_ = 0;
+        if (ch.closed_) {
+            ch.buf_.pop_back();
+            return false;
+        }
+        ch.readHalf().wake();
+        ch.writeHalf().wake();
+        return true;
+    }
+
+    /// Gives the slot back, destroying the object if it has been
+    /// constructed already.
+    void reset() {
+        if (Channel<T>* ch = std::exchange(channel_, nullptr)) {
+            ch->reserved_ = false;
+            if (std::exchange(ch->unpublished_, 0)) {
+                ch->buf_.pop_back();
+            }
+            ch->writeHalf().wake();
+        }
+    }
+
+  private:
+    friend WriteHalf<T>;
+    explicit SendSlot(Channel<T>& channel) : channel_(&channel) {}
+
+    Channel<T>* channel_ = nullptr;
+};
+
+/// The object at the front of a bounded Channel, returned by
+/// Channel::peek(). It stays in the channel's buffer until consume()
+/// destroys it there; dropping the slot without consuming leaves it
+/// in the channel for the next reader.
+///
+/// Only one object can be peeked at a time; until then, the channel
+/// is empty for everybody else.
+template <typename T> class ReceiveSlot {
+  public:
+    /// An empty slot, as returned by tryPeek() if the channel is empty.
+    ReceiveSlot() = default;
+
+    ReceiveSlot(ReceiveSlot&& rhs) noexcept
+      : channel_(std::exchange(rhs.channel_, nullptr)) {}
+    ReceiveSlot& operator=(ReceiveSlot rhs) noexcept {
+        std::swap(channel_, rhs.channel_);
+        return *this;
+    }
+    ~ReceiveSlot() { reset(); }
+
+    /// Returns false if the slot is empty, i.e., there was nothing to
+    /// peek at (for peek(), because the channel is closed and has no
+    /// objects left), or the slot has already been consumed or reset.
+    explicit operator bool() const noexcept { return channel_ != nullptr; }
+
+    T& operator*() const noexcept {
+        CORRAL_ASSERT(channel_);
+        return channel_->buf_.front();
+    }
+    T* operator->() const noexcept { return &**this; }
+
+    /// Removes the object from the channel, destroying it.
+    void consume() {
+        CORRAL_ASSERT(channel_ && "nothing to consume");
+        Channel<T>& ch = *std::exchange(channel_, nullptr);
+        ch.peeked_ = false;
+        ch.buf_.pop_front();
+        ch.writeHalf().wake();
+        ch.readHalf().wake();
+    }
+
+    /// Gives the slot back, leaving the object in the channel.
+    void reset() {
+        if (Channel<T>* ch = std::exchange(channel_, nullptr)) {
+            ch->peeked_ = false;
+            ch->readHalf().wake();
+        }
+    }
+
+  private:
+    friend ReadHalf<T>;
+    explicit ReceiveSlot(Channel<T>& channel) : channel_(&channel) {}
+
+    Channel<T>* channel_ = nullptr;
 };
 
 } // namespace detail::channel
@@ -222,13 +604,31 @@ struct Channel : public detail::channel::ReadHalf<T>,
                  public detail::channel::WriteHalf<T> {
     /// Constructs an unbounded channel. No initial capacity is allocated;
     /// later channel operations will need to allocate to do their work.
-    Channel() : buf_(0), bounded_(false) {}
+    Channel() : bounded_(false) {
+        buf_.setShrinkPolicy({0, ShrinkAfterIdle});
+    }
 
     /// Constructs a bounded channel. Space for `maxSize` buffered objects
     /// of type T will be allocated immediately, and no further allocations
     /// will be performed.
-    explicit Channel(size_t maxSize) : buf_(maxSize), bounded_(true) {
+    explicit Channel(size_t maxSize)
+      : buf_(maxSize), maxSize_(maxSize), bounded_(true) {
+        CORRAL_ASSERT(maxSize > 0);
+    }
+
+    /// Constructs a bounded channel which handles objects sent while it
+    /// is full according to `overflow`. With anything but
+    /// ChannelOverflow::Block, sending never fails nor suspends unless
+    /// the channel is closed, and objects discarded are counted in
+    /// dropped().
+    Channel(size_t maxSize, ChannelOverflow overflow)
+      : buf_(maxSize),
+        maxSize_(maxSize),
+        bounded_(true),
+        overflow_(overflow) {
         CORRAL_ASSERT(maxSize > 0);
+        CORRAL_ASSERT((overflow != ChannelOverflow::Conflate || maxSize == 1) &&
+                      "a conflating channel only ever holds one object");
     }
 
     /// Detect some uses of 'Channel(0)' and fail at compile time.
@@ -238,6 +638,8 @@ struct Channel : public detail::channel::ReadHalf<T>,
     /// Verify that no tasks are still waiting on this Channel when it is
     /// about to be destroyed.
     ~Channel() {
+        CORRAL_ASSERT(!reserved_ && !peeked_ &&
+                      "Still a slot reserved or peeked at in this channel");
         CORRAL_ASSERT(
                 !readHalf().hasWaiters() &&
                 "Still some tasks suspended while reading from this channel");
@@ -248,33 +650,44 @@ struct Channel : public detail::channel::ReadHalf<T>,
 
     /// Returns the number of objects immediately available to read
     /// from this channel, i.e., the number of times in a row that you
-    /// can call tryReceive() successfully.
-    size_t size() const noexcept { return buf_.size(); }
+    /// can call tryReceive() successfully. This does not include
+    /// an object being peeked at, nor anything behind it, nor an object
+    /// constructed in a reserved slot but not committed yet.
+    size_t size() const noexcept {
+        return peeked_ ? 0 : buf_.size() - unpublished_;
+    }
 
     /// Returns true if this channel contains no objects, i.e., a call
     /// to tryReceive() will return std::nullopt.
-    bool empty() const noexcept { return buf_.empty(); }
+    bool empty() const noexcept { return size() == 0; }
 
     /// Returns the number of slots immediately available to write
     /// new objects into this channel, i.e., the number of times in a row
     /// that you can call trySend() successfully.
     size_t space() const noexcept {
-        if (closed_) {
+        if (closed_ || reserved_) {
             return 0;
         }
-        if (!bounded_ && !closed_) {
+        if (!bounded_ || overflow_ != ChannelOverflow::Block) {
             return std::numeric_limits<size_t>::max();
         }
-        return buf_.capacity() - buf_.size();
+        return maxSize_ - buf_.size();
     }
 
     /// Returns true if this channel contains no space for more objects,
     /// i.e., a call to trySend() will return false. This may be because
-    /// the channel is closed or because it has reached its capacity limit.
+    /// the channel is closed, because it has reached its capacity limit,
+    /// or because a slot is currently reserved.
     bool full() const noexcept {
-        return (bounded_ && buf_.capacity() == buf_.size()) || closed_;
+        return (bounded_ && overflow_ == ChannelOverflow::Block &&
+                buf_.size() == maxSize_) ||
+               closed_ || reserved_;
     }
 
+    /// Returns the number of objects discarded so far because of the
+    /// channel's ChannelOverflow mode.
+    size_t dropped() const noexcept { return dropped_; }
+
     /// Returns true if close() has been called on this channel.
     bool closed() const noexcept { return closed_; }
 
@@ -288,8 +701,9 @@ struct Channel : public detail::channel::ReadHalf<T>,
     }
 
     /// A reference to this channel that only exposes the operations that
-    /// would be needed by a reader: receive(), tryReceive(), size(),
-    /// empty(), and closed().
+    /// would be needed by a reader: receive(), tryReceive(), receiveMany(),
+    /// tryReceiveMany(), drain(), peek(), tryPeek(), size(), empty(),
+    /// and closed().
     using ReadHalf = detail::channel::ReadHalf<T>;
     ReadHalf& readHalf() { return static_cast<ReadHalf&>(*this); }
     const ReadHalf& readHalf() const {
@@ -307,9 +721,40 @@ struct Channel : public detail::channel::ReadHalf<T>,
     /// if none are immediately available.
     std::optional<T> tryReceive() { return readHalf().tryReceive(); }
 
+    /// Retrieve up to `out.size()` objects from the channel in one go,
+    /// blocking until at least one is available. Returns the number of
+    /// objects moved into `out`, which is zero only if the channel is
+    /// closed and has no objects left to read, or if `out` is empty
+    /// (in which case this does not block).
+    corral::Awaitable<size_t> auto receiveMany(std::span<T> out) {
+        return readHalf().receiveMany(out);
+    }
+
+    /// Same as above, but returns zero instead of blocking.
+    size_t tryReceiveMany(std::span<T> out) {
+        return readHalf().tryReceiveMany(out);
+    }
+
+    /// Moves every object immediately available to `out`, and returns
+    /// the advanced output iterator.
+    template <std::output_iterator<T> OutIt> OutIt drain(OutIt out) {
+        return readHalf().drain(std::move(out));
+    }
+
+    /// Gives access to the next object in place, without moving it out
+    /// of the channel, blocking until one is available; see ReceiveSlot.
+    /// Returns an empty slot if the channel is closed and has no objects
+    /// left to read. Only available for bounded channels.
+    using ReceiveSlot = detail::channel::ReceiveSlot<T>;
+    corral::Awaitable<ReceiveSlot> auto peek() { return readHalf().peek(); }
+
+    /// Same as above, but returns an empty slot instead of blocking.
+    ReceiveSlot tryPeek() { return readHalf().tryPeek(); }
+
     /// A reference to this channel that only exposes the operations that
-    /// would be needed by a writer: send(), trySend(), close(), space(),
-    /// full(), and closed().
+    /// would be needed by a writer: send(), trySend(), sendMany(),
+    /// trySendMany(), reserve(), tryReserve(), close(), space(), full(),
+    /// dropped(), and closed().
     using WriteHalf = detail::channel::WriteHalf<T>;
     WriteHalf& writeHalf() { return static_cast<WriteHalf&>(*this); }
     const WriteHalf& writeHalf() const {
@@ -327,17 +772,92 @@ struct Channel : public detail::channel::ReadHalf<T>,
     /// Deliver an object to the channel if there is space immediately
     /// available for it in the buffer. Returns true if the object was
     /// delivered, false if there was no space or the channel was closed.
+    /// A channel constructed with a ChannelOverflow mode other than Block
+    /// always has space; objects discarded to make it still count as
+    /// delivered, and are reflected in dropped() instead.
     template <typename U> bool trySend(U&& value) {
         return writeHalf().trySend(std::forward<U>(value));
     }
 
+    /// Deliver objects from `range` to the channel, blocking until there
+    /// is space for at least one of them; then as many as fit are
+    /// delivered in one go. Returns the number of objects delivered,
+    /// which is zero only if the channel has been closed, or if `range`
+    /// is empty (in which case this does not block, unless `range` is
+    /// a single-pass range of unknown size). Objects are copied, unless
+    /// the range yields rvalues (e.g., move iterators).
+    template <std::ranges::input_range Range>
+    corral::Awaitable<size_t> auto sendMany(Range&& range) {
+        return writeHalf().sendMany(std::forward<Range>(range));
+    }
+
+    /// Same as above, but returns zero instead of blocking.
+    template <std::ranges::input_range Range>
+    size_t trySendMany(Range&& range) {
+        return writeHalf().trySendMany(std::forward<Range>(range));
+    }
+
+    /// Reserves a slot for the next object to send, blocking until there
+    /// is space for it, so that the object can be constructed right in
+    /// the channel's buffer; see SendSlot. Returns an empty slot if the
+    /// channel has been closed. Only available for bounded channels.
+    ///
+    ///    auto slot = co_await channel.reserve();
+    ///    Block& block = slot.emplace();
+    ///    device.read(block.data, sizeof(block.data));
+    ///    slot.commit();
+    using SendSlot = detail::channel::SendSlot<T>;
+    corral::Awaitable<SendSlot> auto reserve() {
+        return writeHalf().reserve();
+    }
+
+    /// Same as above, but returns an empty slot instead of blocking.
+    SendSlot tryReserve() { return writeHalf().tryReserve(); }
+
   protected:
     friend ReadHalf;
     friend WriteHalf;
+    friend SendSlot;
+    friend ReceiveSlot;
+
+    /// Called before adding an object; applies overflow_ if the buffer
+    /// is full. Returns false if the object should be dropped instead.
+    bool makeRoom() noexcept {
+        if (!bounded_ || buf_.size() < maxSize_) [[likely]] {
+            return true;
+        }
+        ++dropped_;
+        if (overflow_ == ChannelOverflow::DropNewest) {
+            return false;
+        }
+        // DropOldest or Conflate (full() rules out Block). The size
+        // stays the same, so no reader woken up is left empty-handed.
+        buf_.pop_front();
+        return true;
+    }
+
+    /// An unbounded channel gives back its buffer memory after having
+    /// been drained this many times without getting anywhere near
+    /// as full as it has been.
+    static constexpr const uint32_t ShrinkAfterIdle = 64;
 
     corral::detail::Queue<T> buf_;
+    size_t maxSize_ = 0;
     bool closed_ = false;
     bool bounded_ = false;
+
+    ChannelOverflow overflow_ = ChannelOverflow::Block;
+    size_t dropped_ = 0;
+
+    /// A SendSlot is outstanding.
+    bool reserved_ = false;
+
+    /// 1 if the last object in buf_ has been constructed in a SendSlot
+    /// but not committed yet, so readers must not see it.
+    size_t unpublished_ = 0;
+
+    /// A ReceiveSlot is outstanding.
+    bool peeked_ = false;
 };
 
 } // namespace corral
@@ -0,0 +1,107 @@
+// This file is part of corral, a lightweight C++20 coroutine library.
+//
+// Copyright (c) 2024 Hudson River Trading LLC <opensource@hudson-trading.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "config.h"
+
+namespace corral {
+
+/// A building block for implementing `EventLoopTraits<T>::post()` in
+/// event loops built directly on poll()/epoll() on Linux. The loop
+/// registers fd() for reading and calls dispatch() whenever it becomes
+/// readable:
+///
+///    template <> struct corral::EventLoopTraits<MyLoop> {
+///        // ...
+///        static void post(MyLoop& loop, void (*fn)(void*), void* arg) {
+///            loop.poster.post(fn, arg);
+///        }
+///    };
+///
+/// Only the first post() after a dispatch() writes to the eventfd, so
+/// a burst of posts costs a single wakeup. Executors post at most once
+/// per batch of runSoonFromThread() calls, so the mutex guarding the
+/// pending callbacks is not contended in practice.
+class EventFdPoster {
+  public:
+    EventFdPoster() : fd_(::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+        CORRAL_ASSERT(fd_ >= 0);
+    }
+    ~EventFdPoster() { ::close(fd_); }
+
+    EventFdPoster(const EventFdPoster&) = delete;
+    EventFdPoster& operator=(const EventFdPoster&) = delete;
+
+    /// The descriptor to poll for readability.
+    int fd() const noexcept { return fd_; }
+
+    /// Arranges `fn(arg)` to be called from the next dispatch().
+    /// May be called from any thread.
+    void post(void (*fn)(void*), void* arg) {
+        bool wasEmpty;
+        {
+            std::lock_guard lk(mutex_);
+            wasEmpty = pending_.empty();
+            pending_.emplace_back(fn, arg);
+        }
+        if (wasEmpty) {
+            uint64_t one = 1;
+            [[maybe_unused]] auto ret = ::write(fd_, &one, sizeof(one));
+        }
+    }
+
+    /// Calls everything posted so far. Must be called from the thread
+    /// running the event loop.
+    void dispatch() {
+        uint64_t count;
+        [[maybe_unused]] auto ret = ::read(fd_, &count, sizeof(count));
+        {
+            std::lock_guard lk(mutex_);
+            std::swap(pending_, dispatching_);
+        }
+        for (auto [fn, arg] : dispatching_) {
+            fn(arg);
+        }
+        dispatching_.clear();
+    }
+
+  private:
+    int fd_;
+    std::mutex mutex_;
+    std::vector<std::pair<void (*)(void*), void*>> pending_;
+    std::vector<std::pair<void (*)(void*), void*>> dispatching_;
+};
+
+} // namespace corral
+
+#endif
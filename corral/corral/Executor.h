@@ -26,13 +26,16 @@
 
 #include <stddef.h>
 
+#include <chrono>
 #include <cstdint>
 #include <iterator>
 #include <utility>
 
+#include "ExecutorStats.h"
 #include "config.h"
 #include "defs.h"
 #include "detail/Queue.h"
+#include "detail/RemoteQueue.h"
 #include "detail/ScopeGuard.h"
 #include "detail/platform.h"
 #include "detail/utility.h"
@@ -67,7 +70,9 @@ concept RootAwaitable = Introspectable<Aw> || ImmediateAwaitable<Aw>;
 /// something to run at a time other than "as soon as possible". Anything
 /// other than a task step, including checking for I/O and timeouts,
 /// can only run when the executor is idle; be careful not to starve
-/// your program with a steady flow of ready-to-run tasks.
+/// your program with a steady flow of ready-to-run tasks, or set a
+/// budget (see `setBudget()`) to bound how long a single executor
+/// loop may run.
 ///
 /// There is one executor per root of the corral task tree. That means
 /// that in a typical program that uses `corral::run()`, there is only
@@ -87,6 +92,17 @@ concept RootAwaitable = Introspectable<Aw> || ImmediateAwaitable<Aw>;
 /// event loop on this thread, or else will schedule it to run after whatever
 /// is running currently. `executor->capture()` exposes an interface
 /// to bypass the executor queueing and run a task step synchronously.
+///
+/// Other threads may hand work to the executor through `runSoonFromThread()`;
+/// that is the only executor method which is not confined to its thread.
+///
+/// Each submission carries a `Priority`. The executor keeps a separate
+/// lane for each priority, and always runs the highest-priority callback
+/// available; to keep lower lanes from starving, a non-empty lane which
+/// has been passed over `StarvationLimit` times in a row gets to run one
+/// callback before the higher lanes are looked at again. Priorities only
+/// decide the order within the executor loop; callbacks submitted while
+/// inside `capture()` all run in submission order, like before.
 class Executor {
     using Task = std::pair<void (*)(void*) noexcept, void*>;
     using Tasks = detail::Queue<Task>;
@@ -95,6 +111,39 @@ class Executor {
     struct Capacity {
         static constexpr const size_t Default = 128;
         static constexpr const size_t Small = 4;
+
+        /// Largest capture() buffer kept around for reuse.
+        static constexpr const size_t MaxRecycled = 1024;
+
+        /// Number of executor loops which have to leave the ready queue
+        /// mostly empty before its memory is given back after a burst.
+        static constexpr const uint32_t ShrinkAfterIdle = 256;
+    };
+
+    /// How many callbacks may run from higher-priority lanes while a
+    /// lower-priority lane is non-empty, before the latter gets a turn.
+    static constexpr const uint32_t StarvationLimit = 64;
+
+    /// A callback submitted from another thread through
+    /// runSoonFromThread(). The storage is provided by the caller and
+    /// must stay alive until the callback has been called.
+    class RemoteTask : public detail::RemoteQueueItem<RemoteTask> {
+      public:
+        template <class T>
+        RemoteTask(void (*fn)(T*) noexcept, T* arg)
+          : fn_(reinterpret_cast<void (*)(void*) noexcept>(fn)), arg_(arg) {}
+
+      private:
+        friend Executor;
+        void (*fn_)(void*) noexcept;
+        void* arg_;
+    };
+
+    /// Limits on a single executor loop, see setBudget().
+    /// Zero means unlimited.
+    struct Budget {
+        size_t maxResumptions = 0;
+        std::chrono::nanoseconds maxTime{0};
     };
 
     template <detail::RootAwaitable AwaitableT>
@@ -112,7 +161,12 @@ class Executor {
     explicit Executor(EventLoopID eventLoopID,
                       std::nullptr_t,
                       size_t capacity = Capacity::Default)
-      : eventLoopID_(eventLoopID), buffer_(capacity) {}
+      : eventLoopID_(eventLoopID),
+        buffer_(capacity),
+        high_(Capacity::Small),
+        background_(Capacity::Small) {
+        setShrinkPolicy({capacity, Capacity::ShrinkAfterIdle});
+    }
 
     template <class EventLoopT>
     explicit Executor(EventLoopT&& eventLoop,
@@ -121,7 +175,9 @@ class Executor {
       : Executor(EventLoopTraits<std::decay_t<EventLoopT>>::eventLoopID(
                          eventLoop),
                  rootAwaitable,
-                 capacity) {}
+                 capacity) {
+        initPost(eventLoop);
+    }
 
     template <class EventLoopT>
         requires(!std::convertible_to<EventLoopT, EventLoopID>)
@@ -131,7 +187,9 @@ class Executor {
       : Executor(EventLoopTraits<std::decay_t<EventLoopT>>::eventLoopID(
                          eventLoop),
                  nullptr,
-                 capacity) {}
+                 capacity) {
+        initPost(eventLoop);
+    }
 
     /// Disallow construction from temporary awaitables.
     explicit Executor(auto&&, const auto&&, size_t = 0) = delete;
@@ -143,9 +201,24 @@ class Executor {
         CORRAL_ASSERT(!scheduled_);
 
         CORRAL_ASSERT(buffer_.empty());
+        CORRAL_ASSERT(high_.empty());
+        CORRAL_ASSERT(background_.empty());
+
+        // If this triggers, a callback submitted from another thread
+        // has not run yet, and a wakeup of this executor is still pending.
+        CORRAL_ASSERT(remote_.empty());
+
         if (running_ != nullptr) {
             *running_ = false;
         }
+        if (deferredRun_ != nullptr) {
+            if (deferredRun_->pending) {
+                // Still queued in the event loop, which will free it
+                deferredRun_->executor = nullptr;
+            } else {
+                delete deferredRun_;
+            }
+        }
         if (current() == this) {
             current() = nullptr;
         }
@@ -154,8 +227,11 @@ class Executor {
     /// Arranges `fn(arg)` to be called on the next executor loop,
     /// then runs the executor loop unless already running
     /// (see below for details).
-    template <class T> void runSoon(void (*fn)(T*) noexcept, T* arg) {
-        schedule(fn, arg);
+    template <class T>
+    void runSoon(void (*fn)(T*) noexcept,
+                 T* arg,
+                 Priority priority = Priority::Normal) {
+        schedule(fn, arg, priority);
         runSoon();
     }
 
@@ -170,9 +246,17 @@ class Executor {
     /// in the future, or else the callback will never be called.
     ///
     /// This is an advanced interface that should be used with care.
-    template <class T> void schedule(void (*fn)(T*) noexcept, T* arg) {
-        ready_->emplace_back(reinterpret_cast<void (*)(void*) noexcept>(fn),
-                             arg);
+    template <class T>
+    void schedule(void (*fn)(T*) noexcept,
+                  T* arg,
+                  Priority priority = Priority::Normal) {
+        Tasks* lane = ready_;
+        if (priority != Priority::Normal && ready_ == &buffer_) [[unlikely]] {
+            lane = (priority == Priority::High) ? &high_ : &background_;
+        }
+        stats_.scheduling(lane->size(), lane->capacity());
+        lane->emplace_back(reinterpret_cast<void (*)(void*) noexcept>(fn),
+                           arg);
     }
 
     /// Runs executor loop.
@@ -180,10 +264,10 @@ class Executor {
     /// executor's loop, schedules this executor's event loop to be run
     /// from current executor (therefore not introducing an interruption point).
     ///
-    /// NB: this will continue running executor until its run queue empties,
-    ///     and only then would return so I/O checks can be made.
-    ///     Pay attention not to starve your program with a steady flow
-    ///     of ready tasks.
+    /// NB: this will continue running executor until its run queue empties
+    ///     (or its budget, if any, runs out), and only then would return
+    ///     so I/O checks can be made. Pay attention not to starve your
+    ///     program with a steady flow of ready tasks.
     void runSoon() noexcept {
         if (running_ != nullptr) {
             // do nothing
@@ -197,13 +281,99 @@ class Executor {
         }
     }
 
+    /// Arranges `task`'s callback to be called on the executor's thread;
+    /// unlike everything else here, may be called from any thread.
+    ///
+    /// Submissions are batched: only the one which finds the inbox empty
+    /// wakes up the event loop (through `EventLoopTraits<T>::post()`),
+    /// and the whole batch is then moved onto the run queue in one go
+    /// and executed in a single executor loop. Pushing itself is
+    /// lock-free and does not allocate.
+    ///
+    /// Requires the executor to have been constructed from an event loop
+    /// whose traits implement `post()`. The executor must outlive any
+    /// submitted task.
+    void runSoonFromThread(RemoteTask& task) noexcept {
+        CORRAL_ASSERT(post_ &&
+                      "event loop does not support EventLoopTraits::post()");
+        if (remote_.push(task)) {
+            post_(
+                    eventLoop_, +[](void* ex) {
+                        static_cast<Executor*>(ex)->runRemote();
+                    },
+                    this);
+        }
+    }
+
+    /// Bounds the work done by a single executor loop. Once `budget`
+    /// is used up (whichever limit is hit first), the executor stops,
+    /// leaving the remaining tasks queued, and reschedules itself
+    /// through the event loop, so that I/O and timers get a chance to
+    /// run in between. Tasks are never preempted: a resumption which
+    /// takes long still runs to its next suspension point.
+    ///
+    /// Only affects executor loops started by runSoon(); drain() and
+    /// capture() still run until their queue is empty.
+    ///
+    /// Requires the event loop traits to implement `post()`.
+    /// May throw std::bad_alloc when setting the first non-zero budget.
+    void setBudget(Budget budget) {
+        bool limited = budget.maxResumptions || budget.maxTime.count();
+        CORRAL_ASSERT((post_ || !limited) &&
+                      "event loop does not support EventLoopTraits::post()");
+        if (limited && deferredRun_ == nullptr) {
+            // Allocate now, so that running out of budget (deep inside
+            // a noexcept executor loop) never has to
+            deferredRun_ = new DeferredRun{this};
+        }
+        budget_ = budget;
+    }
+
+    Budget budget() const noexcept { return budget_; }
+
+    /// Controls when the ready queues give back memory after a burst
+    /// of scheduled tasks; see QueueShrinkPolicy. By default, they shrink
+    /// back towards their initial capacity after `Capacity::ShrinkAfterIdle`
+    /// mostly idle executor loops.
+    void setShrinkPolicy(detail::QueueShrinkPolicy policy) noexcept {
+        buffer_.setShrinkPolicy(policy);
+        high_.setShrinkPolicy(policy);
+        background_.setShrinkPolicy(policy);
+    }
+
+    /// Returns the scheduling statistics collected so far.
+    /// Everything is zero unless CORRAL_EXECUTOR_STATS is defined
+    /// (see config.h).
+    ExecutorStats stats() const noexcept { return stats_.get(); }
+
+    /// Returns the priority of the task currently running on this
+    /// executor (Priority::Normal if none is).
+    Priority currentPriority() const noexcept { return currentPriority_; }
+
+    /// Returns the number of times an executor loop was cut short
+    /// because its budget ran out.
+    size_t budgetExhaustedCount() const noexcept {
+        return budgetExhaustedCount_;
+    }
+
     /// Runs the function, temporarily capturing any tasks scheduled into a
     /// separate list. Then runs everything in the list.
     /// NB: tasks scheduled as a result of executing the capture list
     /// go into previously used list.
+    ///
+    /// The list's buffer is recycled between calls, so after the first
+    /// one, capture() does not allocate (unless the list has to grow).
     template <class Fn> void capture(Fn fn, size_t capacity = Capacity::Small) {
-        Tasks tmp{capacity};
-        detail::ScopeGuard guard([&] { drain(tmp); });
+        Tasks tmp = std::move(spareCapture_);
+        if (tmp.capacity() == 0) {
+            tmp = Tasks{capacity};
+        }
+        detail::ScopeGuard guard([&] {
+            if (drain(tmp) && tmp.capacity() <= Capacity::MaxRecycled &&
+                tmp.capacity() > spareCapture_.capacity()) {
+                spareCapture_ = std::move(tmp);
+            }
+        });
 
         Tasks* oldReady = ready_;
         ready_ = &tmp;
@@ -223,17 +393,21 @@ class Executor {
     ///
     /// This is necessary for `collectAsyncStackTrace`. The task will be
     /// automatically deactivated when the returned guard is destroyed.
-    [[nodiscard]] auto markActive(Handle h) noexcept {
+    /// `priority` is the task's priority, which tasks it starts will
+    /// inherit (see currentPriority()).
+    [[nodiscard]] auto markActive(
+            Handle h, Priority priority = Priority::Normal) noexcept {
         // We occasionally enter the Executor recursively, for example, through
         // CBPortal. We stash the currently active coroutine in case we are
         // recursively entering the Executor.
         Handle prev = std::exchange(active_, h);
+        Priority prevPriority = std::exchange(currentPriority_, priority);
 
         // Can call only while in drain().
         bool* running = running_;
         CORRAL_ASSERT(running != nullptr);
 
-        return detail::ScopeGuard([this, h, prev, running]() {
+        return detail::ScopeGuard([this, h, prev, prevPriority, running]() {
             // Silence unused lambda capture warnings for h if CORRAL_ASSERT is
             // compiled away. Unfortunately, [[maybe_unused]] cannot be used on
             // a lambda capture.
@@ -248,6 +422,7 @@ class Executor {
 
             CORRAL_ASSERT(active_ == h);
             active_ = prev;
+            currentPriority_ = prevPriority;
         });
     }
 
@@ -259,16 +434,70 @@ class Executor {
     }
 
   private:
+    template <class EventLoopT> void initPost(EventLoopT& eventLoop) {
+        using Traits = EventLoopTraits<std::decay_t<EventLoopT>>;
+        if constexpr (requires(void (*fn)(void*)) {
+                          Traits::post(eventLoop, fn, nullptr);
+                      }) {
+            eventLoop_ = &eventLoop;
+            post_ = +[](void* loop, void (*fn)(void*), void* arg) {
+                Traits::post(*static_cast<std::decay_t<EventLoopT>*>(loop),
+                             fn, arg);
+            };
+        }
+    }
+
+    /// A runOnce() to be posted to the event loop after the budget
+    /// ran out. Allocated once by setBudget() and reused; lives on
+    /// the heap so that the executor may be destroyed while it is
+    /// still queued in the event loop (which then frees it).
+    struct DeferredRun {
+        Executor* executor;
+        bool pending = false;
+    };
+
+    void deferRun() noexcept {
+        CORRAL_ASSERT(deferredRun_ != nullptr);
+        if (deferredRun_->pending) {
+            return;
+        }
+        deferredRun_->pending = true;
+        post_(
+                eventLoop_, +[](void* arg) {
+                    auto* run = static_cast<DeferredRun*>(arg);
+                    if (Executor* ex = run->executor) {
+                        run->pending = false;
+                        ex->runOnce();
+                    } else {
+                        delete run;
+                    }
+                },
+                deferredRun_);
+    }
+
+    /// Called from the event loop when woken up by runSoonFromThread().
+    void runRemote() noexcept {
+        remote_.takeAll([this](RemoteTask& task) {
+            stats_.scheduling(ready_->size(), ready_->capacity());
+            ready_->emplace_back(task.fn_, task.arg_);
+        });
+        runSoon();
+    }
+
     void runOnce() noexcept {
         scheduled_ = false;
+        stats_.runOnce();
         if (running_ == nullptr) {
             CORRAL_TRACE("--running executor--");
-            drain();
+            drain(*ready_, /* budgeted = */ true);
             CORRAL_TRACE("--executor done--");
         }
     }
 
-    void drain(Tasks& tasks) noexcept {
+    /// Runs tasks from `tasks` (or from all lanes, if `tasks` is
+    /// buffer_) until none are left. Returns false if the executor
+    /// got destroyed while doing so.
+    bool drain(Tasks& tasks, bool budgeted = false) noexcept {
         Executor* prev = current();
         current() = this;
         detail::ScopeGuard guard([&] { current() = prev; });
@@ -278,19 +507,93 @@ class Executor {
             running_ = &b;
         }
         bool* running = running_;
+        auto drainStart = stats_.now();
         detail::ScopeGuard guard2([&] {
             if (*running && running_ == &b) {
                 running_ = nullptr;
+                stats_.drainDone(drainStart);
             }
         });
 
-        while (*running && !tasks.empty()) {
-            auto [fn, arg] = tasks.front();
-            tasks.pop_front();
+        // Only the outermost loop is subject to the budget
+        budgeted = budgeted && running_ == &b;
+        BudgetTracker tracker;
+
+        while (*running) {
+            Tasks* lane = &tasks;
+            if (&tasks == &buffer_ &&
+                (!high_.empty() || !background_.empty())) [[unlikely]] {
+                lane = pickLane();
+            }
+            if (lane->empty()) {
+                break;
+            }
+            if (budgeted && tracker.exhausted(budget_)) [[unlikely]] {
+                ++budgetExhaustedCount_;
+                CORRAL_TRACE("--executor budget exhausted--");
+                deferRun();
+                break;
+            }
+            auto [fn, arg] = lane->front();
+            lane->pop_front();
+            auto start = stats_.now();
             fn(arg);
+            if (*running) {
+                // (otherwise the executor might be gone by now)
+                stats_.callbackDone(start);
+            }
+        }
+        return *running;
+    }
+
+    /// Chooses the lane to take the next callback from: the highest
+    /// priority non-empty one, unless a lower one has been waiting for
+    /// too long.
+    Tasks* pickLane() noexcept {
+        Tasks* lanes[] = {&high_, &buffer_, &background_};
+        for (size_t i = 0; i < std::size(lanes); ++i) {
+            if (lanes[i]->empty()) {
+                continue;
+            }
+            for (size_t j = std::size(lanes) - 1; j > i; --j) {
+                if (!lanes[j]->empty() && ++passedOver_[j] > StarvationLimit) {
+                    passedOver_[j] = 0;
+                    return lanes[j];
+                }
+            }
+            passedOver_[i] = 0;
+            return lanes[i];
         }
+        return &buffer_;
     }
 
+    /// Keeps track of the budget used by one executor loop.
+    /// The clock is only consulted while a time limit is set.
+    class BudgetTracker {
+        using Clock = std::chrono::steady_clock;
+
+      public:
+        bool exhausted(const Budget& budget) noexcept {
+            if (budget.maxResumptions &&
+                resumptions_++ >= budget.maxResumptions) {
+                return true;
+            }
+            if (budget.maxTime.count()) {
+                Clock::time_point now = Clock::now();
+                if (start_ == Clock::time_point{}) {
+                    start_ = now;
+                } else if (now - start_ >= budget.maxTime) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+      private:
+        size_t resumptions_ = 0;
+        Clock::time_point start_{};
+    };
+
     static Executor*& current() noexcept {
         // NB: Executor::current() is the executor that is currently
         // running (i.e., is inside a call to drain()), and will be
@@ -306,8 +609,18 @@ class Executor {
 
   private:
     EventLoopID eventLoopID_;
+
+    /// Lanes of ready tasks, one per priority; buffer_ is the normal one.
     Tasks buffer_;
+    Tasks high_;
+    Tasks background_;
+    uint32_t passedOver_[3] = {};
+
     Handle active_;
+    Priority currentPriority_ = Priority::Normal;
+
+    /// A buffer for capture() to reuse; may be empty.
+    Tasks spareCapture_;
 
     /// Currently used list of ready tasks. Normally points to buffer_,
     /// but can be temporarily replaced from capture().
@@ -319,6 +632,18 @@ class Executor {
     /// in near future.
     bool scheduled_ = false;
 
+    /// The event loop and its EventLoopTraits::post(), if available.
+    void* eventLoop_ = nullptr;
+    void (*post_)(void* loop, void (*fn)(void*), void* arg) = nullptr;
+
+    /// Tasks submitted from other threads.
+    detail::RemoteQueue<RemoteTask> remote_;
+
+    Budget budget_;
+    size_t budgetExhaustedCount_ = 0;
+    [[no_unique_address]] detail::ExecutorStatsCollector stats_;
+    DeferredRun* deferredRun_ = nullptr;
+
     const void* rootAwaitable_ = nullptr;
     void (*collectTaskTree_)(const void* root,
                              detail::TaskTreeCollector&) noexcept = nullptr;
@@ -340,6 +665,18 @@ class GetExecutor {
     Executor* await_resume() { return executor_; }
 };
 
+class GetExecutorStats {
+    Executor* executor_ = nullptr;
+
+  public:
+    void await_set_executor(Executor* executor) noexcept {
+        executor_ = executor;
+    }
+    bool await_ready() const noexcept { return executor_ != nullptr; }
+    Handle await_suspend(Handle h) { return h; }
+    ExecutorStats await_resume() { return executor_->stats(); }
+};
+
 template <std::output_iterator<TreeDumpElement> OutIt> class CollectTreeImpl {
     Executor* executor_ = nullptr;
     OutIt out_;
@@ -378,6 +715,12 @@ inline Awaitable<Executor*> auto getExecutor() {
     return detail::GetExecutor{};
 }
 
+/// Returns an awaitable that you can use in an async context to get
+/// a snapshot of the current executor's statistics (see ExecutorStats).
+inline Awaitable<ExecutorStats> auto executorStats() {
+    return detail::GetExecutorStats{};
+}
+
 /// Obtains the current task tree.
 template <std::output_iterator<TreeDumpElement> OutIt>
 Awaitable<OutIt> auto dumpTaskTree(OutIt out) {
@@ -0,0 +1,164 @@
+// This file is part of corral, a lightweight C++20 coroutine library.
+//
+// Copyright (c) 2024 Hudson River Trading LLC <opensource@hudson-trading.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// SPDX-License-Identifier: MIT
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <bit>
+#include <chrono>
+
+#include "config.h"
+
+namespace corral {
+
+/// A histogram of durations with power-of-two buckets:
+/// `buckets[i]` counts durations in [2^(i-1), 2^i) nanoseconds
+/// (`buckets[0]` counts zero-length ones, and the last bucket
+/// also counts everything longer).
+struct DurationHistogram {
+    static constexpr const size_t Buckets = 40; // up to ~9 minutes
+
+    uint64_t buckets[Buckets] = {};
+    uint64_t count = 0;
+    std::chrono::nanoseconds total{0};
+    std::chrono::nanoseconds max{0};
+
+    void record(std::chrono::nanoseconds d) noexcept {
+        auto ns = static_cast<uint64_t>(d.count() > 0 ? d.count() : 0);
+        size_t bucket = std::bit_width(ns);
+        ++buckets[bucket < Buckets ? bucket : Buckets - 1];
+        ++count;
+        total += d;
+        if (d > max) {
+            max = d;
+        }
+    }
+
+    /// Returns the upper bound of the bucket containing the `q`-th
+    /// quantile (0 <= q <= 1) of recorded durations.
+    std::chrono::nanoseconds quantile(double q) const noexcept {
+        auto rank = static_cast<uint64_t>(q * static_cast<double>(count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < Buckets; ++i) {
+            seen += buckets[i];
+            if (seen > rank) {
+                return std::chrono::nanoseconds(uint64_t(1) << i);
+            }
+        }
+        return max;
+    }
+};
+
+/// A snapshot of executor counters, see Executor::stats().
+///
+/// Only collected if CORRAL_EXECUTOR_STATS is defined (see config.h);
+/// otherwise everything here stays zero.
+struct ExecutorStats {
+    static constexpr const bool Enabled =
+#ifdef CORRAL_EXECUTOR_STATS
+            true;
+#else
+            false;
+#endif
+
+    /// Callbacks submitted to and run by the executor.
+    uint64_t tasksScheduled = 0;
+    uint64_t tasksRun = 0;
+
+    /// Number of times a ready queue had to grow its buffer.
+    uint64_t queueGrowths = 0;
+
+    /// Largest number of callbacks ever waiting in a ready queue.
+    size_t readyHighWater = 0;
+
+    /// Number of executor loops started through runSoon().
+    uint64_t runOnceCount = 0;
+
+    /// Time spent in each (outermost) executor loop,
+    /// and in each individual callback.
+    DurationHistogram drainTime;
+    DurationHistogram callbackTime;
+};
+
+namespace detail {
+
+#ifdef CORRAL_EXECUTOR_STATS
+
+class ExecutorStatsCollector {
+    using Clock = std::chrono::steady_clock;
+
+  public:
+    using TimePoint = Clock::time_point;
+
+    /// Called before pushing into a queue of the given size and capacity.
+    void scheduling(size_t size, size_t capacity) noexcept {
+        ++stats_.tasksScheduled;
+        if (size == capacity) {
+            ++stats_.queueGrowths;
+        }
+        if (size + 1 > stats_.readyHighWater) {
+            stats_.readyHighWater = size + 1;
+        }
+    }
+
+    void runOnce() noexcept { ++stats_.runOnceCount; }
+
+    TimePoint now() const noexcept { return Clock::now(); }
+
+    void callbackDone(TimePoint start) noexcept {
+        ++stats_.tasksRun;
+        stats_.callbackTime.record(Clock::now() - start);
+    }
+
+    void drainDone(TimePoint start) noexcept {
+        stats_.drainTime.record(Clock::now() - start);
+    }
+
+    const ExecutorStats& get() const noexcept { return stats_; }
+
+  private:
+    ExecutorStats stats_;
+};
+
+#else
+
+class ExecutorStatsCollector {
+  public:
+    struct TimePoint {};
+
+    void scheduling(size_t, size_t) noexcept {}
+    void runOnce() noexcept {}
+    TimePoint now() const noexcept { return {}; }
+    void callbackDone(TimePoint) noexcept {}
+    void drainDone(TimePoint) noexcept {}
+    ExecutorStats get() const noexcept { return {}; }
+};
+
+#endif
+
+} // namespace detail
+} // namespace corral
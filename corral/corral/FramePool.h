@@ -0,0 +1,174 @@
+// This file is part of corral, a lightweight C++20 coroutine library.
+//
+// Copyright (c) 2024 Hudson River Trading LLC <opensource@hudson-trading.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// SPDX-License-Identifier: MIT
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+
+#include "config.h"
+
+namespace corral {
+
+/// A per-thread pool of coroutine frames, with a free list for each of
+/// a few size classes. Freed frames are kept for reuse (up to a limit
+/// on the memory held), so a program which keeps starting short-lived
+/// tasks stops hitting the global allocator once warmed up.
+///
+/// Only used if CORRAL_POOLED_FRAMES is defined (see config.h); then
+/// every corral::Task frame (and every promise allocated by just() or
+/// similar) comes from the pool of the thread it is created on. Frames
+/// larger than the largest size class go straight to the global
+/// allocator. A frame freed on another thread simply joins that
+/// thread's pool.
+class FramePool {
+  public:
+    static constexpr const size_t Granularity = 64;
+    static constexpr const size_t SizeClasses = 16; // up to 1KiB
+
+    struct Stats {
+        /// Allocations served from a free list, and those which
+        /// had to go to the global allocator.
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+
+        /// Allocations too large for any size class.
+        uint64_t oversized = 0;
+
+        /// Memory currently held in free lists.
+        size_t bytesHeld = 0;
+
+        double hitRate() const noexcept {
+            uint64_t total = hits + misses;
+            return total ? static_cast<double>(hits) / total : 0.0;
+        }
+    };
+
+    FramePool() = default;
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+    ~FramePool() { trim(); }
+
+    /// Returns the pool for the calling thread.
+    /// Must not be called once it has been destroyed, at thread exit.
+    static FramePool& forThisThread() noexcept {
+        FramePool* pool = tryForThisThread();
+        CORRAL_ASSERT(pool && "FramePool used during thread teardown");
+        return *pool;
+    }
+
+    /// Same as above, but returns nullptr once the pool has been
+    /// destroyed. Frames may well outlive it (e.g. if held by other
+    /// thread-local or static objects), so frame allocation goes
+    /// through this, and falls back to the global allocator then.
+    static FramePool* tryForThisThread() noexcept {
+        // Trivially destructible, so still usable while the thread's
+        // other objects are being destroyed
+        CORRAL_THREAD_LOCAL bool destroyed = false;
+        struct Owned : FramePool {
+            ~Owned() { destroyed = true; }
+        };
+
+        if (destroyed) {
+            return nullptr;
+        }
+        CORRAL_THREAD_LOCAL Owned pool;
+        return &pool;
+    }
+
+    void* allocate(size_t size) {
+        size_t cls = sizeClass(size);
+        if (cls >= SizeClasses) [[unlikely]] {
+            ++stats_.oversized;
+            return ::operator new(size);
+        }
+        if (FreeBlock* block = free_[cls]) {
+            free_[cls] = block->next;
+            stats_.bytesHeld -= classSize(cls);
+            ++stats_.hits;
+            return block;
+        }
+        ++stats_.misses;
+        return ::operator new(classSize(cls));
+    }
+
+    /// `size` must be the same as passed to the allocate() call which
+    /// returned `ptr`.
+    void deallocate(void* ptr, size_t size) noexcept {
+        size_t cls = sizeClass(size);
+        if (cls >= SizeClasses) [[unlikely]] {
+            ::operator delete(ptr);
+            return;
+        }
+        if (stats_.bytesHeld + classSize(cls) > maxBytesHeld_) {
+            ::operator delete(ptr);
+            return;
+        }
+        free_[cls] = new (ptr) FreeBlock{free_[cls]};
+        stats_.bytesHeld += classSize(cls);
+    }
+
+    /// Limits the amount of memory kept in free lists; anything freed
+    /// beyond that goes back to the global allocator.
+    void setMaxBytesHeld(size_t bytes) noexcept {
+        maxBytesHeld_ = bytes;
+        if (stats_.bytesHeld > bytes) {
+            trim();
+        }
+    }
+
+    /// Returns all memory held in free lists to the global allocator.
+    void trim() noexcept {
+        for (size_t cls = 0; cls < SizeClasses; ++cls) {
+            while (FreeBlock* block = free_[cls]) {
+                free_[cls] = block->next;
+                ::operator delete(block);
+            }
+        }
+        stats_.bytesHeld = 0;
+    }
+
+    const Stats& stats() const noexcept { return stats_; }
+
+  private:
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    static size_t sizeClass(size_t size) noexcept {
+        return size ? (size - 1) / Granularity : 0;
+    }
+    static size_t classSize(size_t cls) noexcept {
+        return (cls + 1) * Granularity;
+    }
+
+    FreeBlock* free_[SizeClasses] = {};
+    size_t maxBytesHeld_ = 4 << 20;
+    Stats stats_;
+};
+
+} // namespace corral
@@ -0,0 +1,211 @@
+// This file is part of corral, a lightweight C++20 coroutine library.
+//
+// Copyright (c) 2024 Hudson River Trading LLC <opensource@hudson-trading.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// SPDX-License-Identifier: MIT
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include "FramePool.h"
+#include "config.h"
+
+namespace corral {
+
+/// Allocation statistics for one coroutine function, see frameProfile().
+struct FrameProfileEntry {
+    /// An address within the coroutine function (namely, the one of its
+    /// initial suspension point). Symbolize it the same way as
+    /// the addresses reported by dumpTaskTree() or collectAsyncStackTrace(),
+    /// e.g. with addr2line.
+    uintptr_t pc;
+
+    /// Size of the coroutine frame, as requested from operator new.
+    size_t frameSize;
+
+    /// Frames currently allocated, the largest number of frames ever
+    /// allocated at once, and the total number of frames allocated.
+    uint64_t live;
+    uint64_t peak;
+    uint64_t total;
+
+    size_t liveBytes() const noexcept { return frameSize * live; }
+};
+
+namespace detail {
+
+/// Allocates coroutine frames for tasks, either from FramePool
+/// or from the global allocator, depending on CORRAL_POOLED_FRAMES.
+inline void* allocateFrameMemory(size_t size) {
+#ifdef CORRAL_POOLED_FRAMES
+    if (FramePool* pool = FramePool::tryForThisThread()) {
+        return pool->allocate(size);
+    }
+    return ::operator new(size);
+#else
+    return ::operator new(size);
+#endif
+}
+
+inline void deallocateFrameMemory(void* ptr, size_t size) noexcept {
+#ifdef CORRAL_POOLED_FRAMES
+    if (FramePool* pool = FramePool::tryForThisThread()) {
+        pool->deallocate(ptr, size);
+    } else {
+        // The size may have been rounded up by the pool
+        ::operator delete(ptr);
+    }
+#else
+    ::operator delete(ptr, size);
+#endif
+}
+
+/// Keeps per-coroutine-function frame statistics for
+/// CORRAL_FRAME_PROFILER (see config.h).
+///
+/// Each frame is prefixed with a small header recording its size and
+/// the coroutine function it belongs to. The latter is only known once
+/// the task reaches its initial suspension point, which is when
+/// attach() is called; stub promises (as made by just()) never get
+/// there and are not accounted for.
+class FrameProfiler {
+  public:
+    struct Entry {
+        size_t frameSize = 0; // guarded by Registry::mutex
+        std::atomic<uint64_t> live{0};
+        std::atomic<uint64_t> peak{0};
+        std::atomic<uint64_t> total{0};
+    };
+
+    static void* allocate(size_t size) {
+        void* raw = allocateFrameMemory(size + sizeof(Header));
+        new (raw) Header{size, unattached()};
+        return static_cast<Header*>(raw) + 1;
+    }
+
+    static void deallocate(void* ptr, size_t size) noexcept {
+        Header* header = static_cast<Header*>(ptr) - 1;
+        if (Entry* entry = header->entry; entry != unattached()) {
+            entry->live.fetch_sub(1, std::memory_order_relaxed);
+        }
+        deallocateFrameMemory(header, size + sizeof(Header));
+    }
+
+    /// Attributes the frame starting at `frame` (which must have come
+    /// from allocate()) to the coroutine function containing `pc`.
+    static void attach(void* frame, uintptr_t pc) noexcept {
+        Header* header = static_cast<Header*>(frame) - 1;
+        if (header->entry != unattached()) {
+            return;
+        }
+        Registry& r = registry();
+        Entry* entry;
+        {
+            // frameSize is read by report() under the same lock
+            std::lock_guard lk(r.mutex);
+            entry = &r.entries[pc];
+            entry->frameSize = header->size;
+        }
+        entry->total.fetch_add(1, std::memory_order_relaxed);
+        uint64_t live = entry->live.fetch_add(1, std::memory_order_relaxed) + 1;
+        uint64_t peak = entry->peak.load(std::memory_order_relaxed);
+        while (peak < live && !entry->peak.compare_exchange_weak(
+                                      peak, live, std::memory_order_relaxed)) {
+        }
+        header->entry = entry;
+    }
+
+    template <class OutIt> static OutIt report(OutIt out) {
+        Registry& r = registry();
+        std::lock_guard lk(r.mutex);
+        for (auto& [pc, entry] : r.entries) {
+            *out++ = FrameProfileEntry{
+                    pc, entry.frameSize,
+                    entry.live.load(std::memory_order_relaxed),
+                    entry.peak.load(std::memory_order_relaxed),
+                    entry.total.load(std::memory_order_relaxed)};
+        }
+        return out;
+    }
+
+  private:
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Header {
+        size_t size;
+        Entry* entry;
+    };
+
+    struct Registry {
+        std::mutex mutex;
+        std::unordered_map<uintptr_t, Entry> entries;
+    };
+
+    static Entry* unattached() noexcept {
+        static Entry dummy;
+        return &dummy;
+    }
+
+    static Registry& registry() noexcept {
+        // Leaked on purpose, so frames freed during static destruction
+        // have something to report to.
+        static Registry* r = new Registry;
+        return *r;
+    }
+};
+
+} // namespace detail
+
+/// Writes allocation statistics for each coroutine function which
+/// has created a task so far to `*out++`, as FrameProfileEntry objects.
+///
+/// Nothing is recorded unless CORRAL_FRAME_PROFILER is defined
+/// (see config.h).
+template <std::output_iterator<FrameProfileEntry> OutIt>
+OutIt frameProfile(OutIt out) {
+#ifdef CORRAL_FRAME_PROFILER
+    return detail::FrameProfiler::report(out);
+#else
+    return out;
+#endif
+}
+
+/// Returns frame statistics for all coroutine functions,
+/// the ones holding the most memory first.
+inline std::vector<FrameProfileEntry> frameProfile() {
+    std::vector<FrameProfileEntry> ret;
+    frameProfile(std::back_inserter(ret));
+    std::sort(ret.begin(), ret.end(), [](const auto& a, const auto& b) {
+        return a.liveBytes() > b.liveBytes();
+    });
+    return ret;
+}
+
+} // namespace corral
@@ -24,10 +24,12 @@
 
 #pragma once
 #include <functional>
+#include <tuple>
 #include <variant>
 #include <vector>
 
 #include "Executor.h"
+#include "NurseryStats.h"
 #include "Task.h"
 #include "detail/IntrusiveList.h"
 #include "detail/ParkingLot.h"
@@ -45,6 +47,73 @@ struct CancelTag {
     explicit constexpr CancelTag(TagCtor) {}
 };
 using NurseryBodyRetval = std::variant<JoinTag, CancelTag>;
+
+template <class R> struct FnPtrTo {
+    template <class... Args> using With = R (*)(Args...);
+};
+
+/// Tells whether the parameter list of `Sig` takes `Args...` without
+/// referring to anything owned by the caller: each parameter is taken
+/// by value and has exactly the type of its argument (so views like
+/// std::string_view or std::span are not built from an argument which
+/// is about to go away), or the caller has passed a
+/// std::reference_wrapper (and is then responsible for the referent's
+/// lifetime anyway).
+template <class Sig, size_t Offset, class... Args>
+constexpr bool paramsOwnArgs() {
+    if constexpr (Sig::Arity + Offset != sizeof...(Args)) {
+        return false;
+    } else {
+        using ArgTuple = std::tuple<std::decay_t<Args>...>;
+        return []<size_t... I>(std::index_sequence<I...>) {
+            return ((std::is_same_v<
+                             std::tuple_element_t<I + Offset, ArgTuple>,
+                             typename Sig::template Arg<I>> ||
+                     is_reference_wrapper_v<
+                             std::tuple_element_t<I + Offset, ArgTuple>>) &&
+                    ...);
+        }(std::make_index_sequence<Sig::Arity>{});
+    }
+}
+
+/// Tells whether the task returned by `callable(args...)` can be started
+/// in a nursery directly, rather than from within a wrapper coroutine
+/// which keeps the callable and its arguments alive. This is the case if
+/// the task doesn't refer to anything such a wrapper would own, i.e.,
+/// the callable is a function pointer, a captureless lambda, or a member
+/// function pointer invoked on an object pointer, and paramsOwnArgs().
+template <class Callable, class... Args> constexpr bool canStartInPlace() {
+    if constexpr (!std::is_same_v<std::invoke_result_t<Callable, Args...>,
+                                  Task<>>) {
+        return false;
+    } else if constexpr (!HasCallableSignature<Callable>) {
+        // Can't look at the parameters (e.g. a ref-qualified member
+        // function), so play it safe
+        return false;
+    } else if constexpr (std::is_member_function_pointer_v<Callable>) {
+        if constexpr (sizeof...(Args) == 0) {
+            return false;
+        } else {
+            using Obj = std::tuple_element_t<0, std::tuple<Args...>>;
+            return (std::is_pointer_v<Obj> || is_reference_wrapper_v<Obj>) &&
+                   paramsOwnArgs<CallableSignature<Callable>, 1, Args...>();
+        }
+    } else if constexpr (std::is_pointer_v<Callable>) {
+        return paramsOwnArgs<CallableSignature<Callable>, 0, Args...>();
+    } else if constexpr (std::is_empty_v<Callable> &&
+                         requires { &Callable::operator(); }) {
+        using Sig = CallableSignature<Callable>;
+        if constexpr (!paramsOwnArgs<Sig, 0, Args...>()) {
+            return false;
+        } else {
+            return std::is_convertible_v<
+                    Callable, typename Sig::template BindArgs<
+                                      FnPtrTo<Task<>>::template With>>;
+        }
+    } else {
+        return false;
+    }
+}
 }; // namespace detail
 
 static constexpr detail::JoinTag join{detail::TagCtor{}};
@@ -102,10 +171,19 @@ class Nursery : private detail::TaskParent<void> {
     co_yield ::corral::Nursery::Factory{} % [&](::corral::Nursery & argname)   \
             -> ::corral::Task<::corral::detail::NurseryBodyRetval>
 
-    ~Nursery() { CORRAL_ASSERT(tasks_.empty()); }
+    ~Nursery() {
+        CORRAL_ASSERT(taskCount_ == 0);
+        if (cancelCursor_) {
+            cancelCursor_->nursery = nullptr;
+        }
+    }
 
     size_t taskCount() const noexcept { return taskCount_; }
 
+    /// Returns the nursery's task counters; everything but `live`
+    /// is zero unless CORRAL_NURSERY_STATS is defined (see config.h).
+    NurseryStats stats() const noexcept { return stats_.get(taskCount_); }
+
     /// Starts a task in the nursery that runs
     /// `co_await std::invoke(c, args...)`.
     /// The callable and its arguments will be moved into storage that
@@ -116,40 +194,87 @@ class Nursery : private detail::TaskParent<void> {
         requires(Awaitable<std::invoke_result_t<Callable, Args...>>)
     void start(Callable c, Args... args);
 
+    /// Same as start(), but the new task runs with the given priority
+    /// rather than with the nursery's one.
+    template <class Callable, class... Args>
+        requires(Awaitable<std::invoke_result_t<Callable, Args...>>)
+    void startWithPriority(Priority priority, Callable c, Args... args);
+
+    /// Sets the priority for tasks subsequently started in the nursery
+    /// (see Executor for what it means). A nursery initially has
+    /// the priority of the task which opened it; the priority of
+    /// an UnsafeNursery is initially Priority::Normal.
+    void setPriority(Priority priority) noexcept { priority_ = priority; }
+    Priority priority() const noexcept { return priority_; }
+
     /// Requests cancellation of all tasks.
+    ///
+    /// Large nurseries are cancelled incrementally: tasks get their
+    /// cancellation requests in batches of `CancelBatch`, one batch per
+    /// executor callback, so other ready tasks (and, if the executor
+    /// has a budget, the event loop) get to run in between.
     void cancel();
 
+    static constexpr const size_t CancelBatch = 1024;
+
     /// Returns the executor for this nursery. This may be nullptr if the
     /// nursery is closed (meaning no new tasks can be started in it).
     Executor* executor() const noexcept { return executor_; }
 
-    template <class Callable> class Scope;
+    template <class Callable, class NurseryT = Nursery> class Scope;
 
   protected:
     template <class Derived> class ParentAwaitable;
 
+    /// Returns the task that start() would run for `c(args...)`.
+    template <class Callable, class... Args>
+    static Task<void> makeTask(Callable c, Args... args);
+
     Nursery() = default;
     Nursery(Nursery&&) = default;
 
-    void doStart(Task<void> t) { addTask(std::move(t), this).resume(); }
+    void doStart(Task<void> t, Priority priority) {
+        addTask(std::move(t), this, priority).resume();
+    }
 
     void rethrowException();
     static std::exception_ptr cancellationRequest();
 
     template <class Ret>
-    Handle addTask(Task<Ret> task, TaskParent<Ret>* parent);
+    Handle addTask(Task<Ret> task, TaskParent<Ret>* parent, Priority priority);
 
     /// TaskParent implementation
     Handle continuation(detail::BasePromise* promise) noexcept override;
     void storeSuccess() override {}
     void storeException() override;
+    void cancelled() override { stats_.taskCancelled(); }
 
     void doCancel();
 
+    /// Tracks an incremental cancellation (see cancel()). Owned by
+    /// the executor callback processing the next batch, so that it may
+    /// notice if the nursery has gone away in the meantime.
+    struct CancelCursor {
+        Nursery* nursery;
+    };
+    static void cancelBatch(CancelCursor* cursor) noexcept;
+
+    void introspectStats(detail::TaskTreeCollector& c) const noexcept {
+        if constexpr (NurseryStats::Enabled) {
+            c.footnote(stats_.describe(taskCount_));
+        }
+    }
+
   protected:
     Executor* executor_ = nullptr;
     detail::IntrusiveList<detail::BasePromise> tasks_;
+    /// Tasks yet to receive a cancellation request, while an incremental
+    /// cancellation is in progress. Counted in taskCount_ as well.
+    detail::IntrusiveList<detail::BasePromise> pendingCancel_;
+    CancelCursor* cancelCursor_ = nullptr;
     size_t taskCount_ = 0;
+    [[no_unique_address]] detail::NurseryStatsCollector stats_;
+    Priority priority_ = Priority::Normal;
     Handle parent_ = nullptr;
     std::exception_ptr exception_;
 };
@@ -203,7 +328,7 @@ class UnsafeNursery final : public Nursery, private Executor {
     // This is in UnsafeNursery because a regular nursery is never
     // observably empty (it will resume its parent, thus destroying
     // the nursery, as soon as it has no tasks left)
-    bool empty() const noexcept { return tasks_.empty(); }
+    bool empty() const noexcept { return taskCount_ == 0; }
 
     ~UnsafeNursery() { close(); }
 
@@ -214,7 +339,7 @@ class UnsafeNursery final : public Nursery, private Executor {
     /// the nursery is closed and any attempt to submit more tasks to it
     /// will produce undefined behavior.
     void close() {
-        if (!tasks_.empty()) {
+        if (taskCount_ != 0) {
             this->schedule(
                     +[](UnsafeNursery* self) noexcept { self->cancel(); },
                     this);
@@ -234,7 +359,7 @@ class UnsafeNursery final : public Nursery, private Executor {
     void asyncClose(std::invocable<> auto continuation) {
         CORRAL_ASSERT(parent_ == nullptr &&
                       "nursery already joined or asyncClose()d");
-        if (tasks_.empty()) {
+        if (taskCount_ == 0) {
             executor_ = nullptr;
             continuation();
         } else {
@@ -251,7 +376,7 @@ class UnsafeNursery final : public Nursery, private Executor {
     }
 
     void assertEmpty() {
-        if (!tasks_.empty()) {
+        if (taskCount_ != 0) {
             CORRAL_FAIL_FOR_DANGLING_TASKS(
                     "UnsafeNursery destroyed with tasks still active", *this);
         }
@@ -272,9 +397,13 @@ class UnsafeNursery final : public Nursery, private Executor {
                       detail::IntrusiveListItem<detail::BasePromise>,
                       detail::BasePromise>);
         c.node("UnsafeNursery");
+        introspectStats(c);
         for (auto& t : tasks_) {
             c.child(t);
         }
+        for (auto& t : pendingCancel_) {
+            c.child(t);
+        }
     }
 };
 
@@ -304,7 +433,9 @@ inline void Nursery::rethrowException() {
 }
 
 template <class Ret>
-inline Handle Nursery::addTask(Task<Ret> task, TaskParent<Ret>* parent) {
+inline Handle Nursery::addTask(Task<Ret> task,
+                               TaskParent<Ret>* parent,
+                               Priority priority) {
     CORRAL_ASSERT(executor_ && "Nursery is closed to new arrivals");
 
     detail::Promise<Ret>* promise = task.release();
@@ -314,15 +445,31 @@ inline Handle Nursery::addTask(Task<Ret> task, TaskParent<Ret>* parent) {
     if (exception_) {
         promise->cancel();
     }
+    stats_.taskStarted(taskCount_);
     tasks_.push_back(*promise);
     ++taskCount_;
-    promise->setExecutor(executor_);
+    promise->setExecutor(executor_, priority);
     return promise->start(parent, parent_);
 }
 
 template <class Callable, class... Args>
     requires(Awaitable<std::invoke_result_t<Callable, Args...>>)
 void Nursery::start(Callable callable, Args... args) {
+    startWithPriority(priority_, std::move(callable), std::move(args)...);
+}
+
+template <class Callable, class... Args>
+    requires(Awaitable<std::invoke_result_t<Callable, Args...>>)
+void Nursery::startWithPriority(Priority priority,
+                                Callable callable,
+                                Args... args) {
+    doStart(makeTask<Callable, Args...>(std::forward<Callable>(callable),
+                                        std::move(args)...),
+            priority);
+}
+
+template <class Callable, class... Args>
+Task<void> Nursery::makeTask(Callable callable, Args... args) {
     if constexpr ((std::is_reference_v<Callable> &&
                    std::is_invocable_r_v<Task<>, Callable>) ||
                   std::is_convertible_v<Callable, Task<> (*)()>) {
@@ -331,7 +478,28 @@ void Nursery::start(Callable callable, Args... args) {
         // and no arguments were supplied.
         // In this case, we don't have to worry about the lifetime of its
         // captures, and can thus save an allocation here.
-        doStart(callable());
+        return callable();
+    } else if constexpr (detail::canStartInPlace<Callable, Args...>()) {
+        // The task only refers to its own parameters (which the coroutine
+        // frame holds on to), so there is no need for a wrapper coroutine
+        // to keep anything alive; call the function directly, saving a
+        // frame and a resumption.
+        if constexpr (std::is_member_function_pointer_v<Callable>) {
+            return [&](auto obj, auto&&... a) {
+                if constexpr (std::is_pointer_v<decltype(obj)>) {
+                    return (obj->*callable)(std::move(a)...);
+                } else {
+                    return (obj.get().*callable)(std::move(a)...);
+                }
+            }(std::move(args)...);
+        } else if constexpr (std::is_pointer_v<Callable>) {
+            return callable(std::move(args)...);
+        } else {
+            using FnPtr = typename detail::CallableSignature<
+                    Callable>::template BindArgs<detail::FnPtrTo<Task<>>::
+                                                         template With>;
+            return static_cast<FnPtr>(callable)(std::move(args)...);
+        }
     } else {
         // The lambda has captures, or we're working with a different
         // awaitable type, so wrap it into another async function.
@@ -344,7 +512,7 @@ void Nursery::start(Callable callable, Args... args) {
         // We need funciton call and `co_await` inside one statement,
         // so mimic `std::invoke()` logic here.
         if constexpr (std::is_member_pointer_v<Callable>) {
-            doStart([](Callable c, auto obj, auto... a) -> Task<> {
+            return [](Callable c, auto obj, auto... a) -> Task<> {
                 if constexpr (std::is_pointer_v<decltype(obj)>) {
                     co_await (obj->*c)(std::move(a)...);
                 } else if constexpr (detail::is_reference_wrapper_v<
@@ -353,38 +521,90 @@ void Nursery::start(Callable callable, Args... args) {
                 } else {
                     co_await (std::move(obj).*c)(std::move(a)...);
                 }
-            }(std::move(callable), std::move(args)...));
+            }(std::move(callable), std::move(args)...);
         } else {
-            doStart([](Callable c, Args... a) -> Task<> {
+            return [](Callable c, Args... a) -> Task<> {
                 co_await (std::move(c))(std::move(a)...);
-            }(std::move(callable), std::move(args)...));
+            }(std::move(callable), std::move(args)...);
         }
     }
 }
 
 inline void Nursery::doCancel() {
-    if (!executor_ || tasks_.empty()) {
+    if (!executor_ || taskCount_ == 0) {
         return;
     }
 
-    // Task cancellation may modify tasks_ arbitrarily,
-    // invalidating iterators to task being cancelled or its
-    // neighbors, thereby making it impossible to traverse through
-    // tasks_ safely; so defer calling cancel() through the executor.
     Executor* ex = executor_;
+    if (taskCount_ <= CancelBatch) {
+        // Task cancellation may modify tasks_ arbitrarily,
+        // invalidating iterators to task being cancelled or its
+        // neighbors, thereby making it impossible to traverse through
+        // tasks_ safely; so defer calling cancel() through the executor.
+        ex->capture(
+                [this] {
+                    for (detail::BasePromise& t : tasks_) {
+                        executor_->schedule(
+                                +[](detail::BasePromise* p) noexcept {
+                                    p->cancel();
+                                },
+                                &t);
+                    }
+                },
+                taskCount_);
+    } else {
+        // Too many tasks to cancel them all in one go; move them aside
+        // and have cancelBatch() work through them. (Tasks exiting
+        // meanwhile can still unlink themselves from pendingCancel_.)
+        CORRAL_ASSERT(!cancelCursor_);
+        pendingCancel_.splice(tasks_);
+        cancelCursor_ = new CancelCursor{this};
+        ex->schedule(&Nursery::cancelBatch, cancelCursor_);
+    }
+
+    ex->runSoon();
+}
+
+inline void Nursery::cancelBatch(CancelCursor* cursor) noexcept {
+    Nursery* self = cursor->nursery;
+    if (!self || self->pendingCancel_.empty()) {
+        // Nursery is gone, or the remaining tasks exited on their own
+        if (self) {
+            self->cancelCursor_ = nullptr;
+        }
+        delete cursor;
+        return;
+    }
+
+    // Same as in doCancel(); note that the nursery may get destroyed
+    // while the captured cancellations run, so decide on the next batch
+    // beforehand.
+    Executor* ex = self->executor_;
+    bool more = false;
     ex->capture(
-            [this] {
-                for (detail::BasePromise& t : tasks_) {
-                    executor_->schedule(
+            [&] {
+                for (size_t i = 0;
+                     i < CancelBatch && !self->pendingCancel_.empty(); ++i) {
+                    detail::BasePromise& t = self->pendingCancel_.front();
+                    self->tasks_.push_back(t);
+                    ex->schedule(
                             +[](detail::BasePromise* p) noexcept {
                                 p->cancel();
                             },
                             &t);
                 }
+                more = !self->pendingCancel_.empty();
+                if (!more) {
+                    self->cancelCursor_ = nullptr;
+                }
             },
-            taskCount_);
+            CancelBatch);
 
-    ex->runSoon();
+    if (more && cursor->nursery) {
+        ex->schedule(&Nursery::cancelBatch, cursor);
+    } else {
+        delete cursor;
+    }
 }
 
 inline void Nursery::cancel() {
@@ -404,6 +624,7 @@ inline void Nursery::storeException() {
         // one we can pass our exception to, so we have no choice but to...
         std::terminate();
     }
+    stats_.taskFailed();
     bool needCancel = (!exception_);
     if (!exception_ || exception_ == cancellationRequest()) {
         exception_ = std::current_exception();
@@ -417,14 +638,15 @@ inline void Nursery::storeException() {
 inline Handle Nursery::continuation(detail::BasePromise* promise) noexcept {
     CORRAL_TRACE("pr %p done in nursery %p (%zu tasks remaining)", promise,
                  this, taskCount_ - 1);
-    tasks_.erase(*promise);
+    stats_.taskFinished(taskCount_);
+    tasks_.erase(*promise); // or from pendingCancel_
     --taskCount_;
 
     Executor* executor = executor_;
     Handle ret = noopHandle();
     // NB: in an UnsafeNursery, parent_ is the task that called join(), or
     // nullptr if no one has yet
-    if (tasks_.empty() && parent_ != nullptr) {
+    if (taskCount_ == 0 && parent_ != nullptr) {
         ret = std::exchange(parent_, nullptr);
         executor_ = nullptr; // nursery is now closed
     }
@@ -483,7 +705,7 @@ class UnsafeNursery::Awaitable : public Nursery::ParentAwaitable<Awaitable> {
     bool await_ready() const noexcept { return nursery_.executor_ == nullptr; }
     bool await_suspend(Handle h) {
         CORRAL_ASSERT(!nursery_.parent_);
-        if (nursery_.tasks_.empty()) {
+        if (nursery_.taskCount_ == 0) {
             // Just close the nursery, don't actually suspend
             nursery_.executor_ = nullptr;
             return false;
@@ -504,36 +726,50 @@ inline corral::Awaitable<void> auto UnsafeNursery::join() {
 // Nursery construction
 //
 
-template <class Callable>
-class Nursery::Scope : public detail::NurseryScopeBase,
-                       public Nursery::ParentAwaitable<Scope<Callable>>,
-                       private detail::TaskParent<detail::NurseryBodyRetval> {
-    class Impl : public Nursery {
+template <class Callable, class NurseryT>
+class Nursery::Scope
+  : public detail::NurseryScopeBase,
+    public Nursery::ParentAwaitable<Scope<Callable, NurseryT>>,
+    private detail::TaskParent<detail::NurseryBodyRetval> {
+    class Impl : public NurseryT {
       public:
         Impl() = default;
+        template <class... Args>
+        explicit Impl(Args&&... args) : NurseryT(std::forward<Args>(args)...) {}
         Impl(Impl&&) noexcept = default;
 
         void introspect(detail::TaskTreeCollector& c) const noexcept {
             c.node("Nursery");
-            for (auto& t : tasks_) {
+            this->introspectStats(c);
+            for (auto& t : this->tasks_) {
+                c.child(t);
+            }
+            for (auto& t : this->pendingCancel_) {
                 c.child(t);
             }
         }
     };
 
   public:
-    explicit Scope(Callable&& c) : callable_(std::move(c)) {}
-
-    void await_set_executor(Executor* ex) noexcept { nursery_.executor_ = ex; }
+    template <class... NurseryArgs>
+    explicit Scope(Callable&& c, NurseryArgs&&... nurseryArgs)
+      : callable_(std::move(c)),
+        nursery_(std::forward<NurseryArgs>(nurseryArgs)...) {}
+
+    void await_set_executor(Executor* ex) noexcept {
+        nursery_.executor_ = ex;
+        nursery_.priority_ = ex->currentPriority();
+    }
 
     bool await_ready() const noexcept { return false; }
 
     Handle await_suspend(Handle h) {
         nursery_.parent_ = h;
-        Task<detail::NurseryBodyRetval> body = callable_(nursery_);
+        Task<detail::NurseryBodyRetval> body =
+                callable_(static_cast<NurseryT&>(nursery_));
         CORRAL_TRACE("    ... nursery %p starting with task %p", &nursery_,
                      body.promise_.get());
-        return nursery_.addTask(std::move(body), this);
+        return nursery_.addTask(std::move(body), this, nursery_.priority_);
     }
 
     void await_introspect(detail::TaskTreeCollector& c) const noexcept {
@@ -547,6 +783,7 @@ class Nursery::Scope : public detail::NurseryScopeBase,
         }
     }
     void storeException() override { nursery_.storeException(); }
+    void cancelled() override { nursery_.cancelled(); }
     Handle continuation(detail::BasePromise* promise) noexcept override {
         return nursery_.continuation(promise);
     }
@@ -587,4 +824,171 @@ inline Task<void> openNursery(Nursery*& ptr) {
     };
 }
 
+
+/// A nursery which runs at most a given number of tasks at once:
+///
+///     CORRAL_WITH_BOUNDED_NURSERY(n, 32) {
+///         for (auto& device : devices) {
+///             co_await n.start(updateFirmware, &device);
+///         }
+///         co_return corral::join;
+///     };
+///
+/// Here start() is awaitable, and suspends the caller until a slot is
+/// free. The callable and its arguments wait in the awaitable (i.e., in
+/// the caller's frame), and the task is only created once it gets
+/// a slot, so memory use is proportional to the limit rather than to the
+/// number of tasks submitted. Slots are handed out in FIFO order.
+///
+/// Otherwise, this behaves exactly like a Nursery: an exception from any
+/// task cancels the rest (including any start() still waiting for
+/// a slot) and is rethrown to the parent, and cancelling the parent
+/// cancels everything. The nursery body does not occupy a slot.
+///
+/// Note that passing a BoundedNursery as a plain `Nursery&` allows
+/// starting tasks which bypass the limit.
+class BoundedNursery : public Nursery,
+                       public detail::ParkingLotImpl<BoundedNursery> {
+    using Lot = detail::ParkingLotImpl<BoundedNursery>;
+    template <class Callable, class... Args> class StartAwaitable;
+
+  public:
+    struct Factory;
+
+#define CORRAL_WITH_BOUNDED_NURSERY(argname, limit)                            \
+    co_yield ::corral::BoundedNursery::Factory{limit} %                        \
+            [&](::corral::BoundedNursery & argname)                            \
+            -> ::corral::Task<::corral::detail::NurseryBodyRetval>
+
+    /// Returns an awaitable which waits for a free slot, then starts a task
+    /// running `co_await std::invoke(c, args...)` in it. See Nursery::start()
+    /// for details on how `c` and `args` are stored.
+    template <class Callable, class... Args>
+        requires(Awaitable<std::invoke_result_t<Callable, Args...>>)
+    [[nodiscard]] corral::Awaitable<void> auto start(Callable c, Args... args) {
+        return StartAwaitable<Callable, Args...>(*this, std::move(c),
+                                                 std::move(args)...);
+    }
+
+    /// Returns the concurrency limit.
+    size_t limit() const noexcept { return limit_; }
+
+    /// Returns the number of slots currently taken.
+    size_t running() const noexcept { return running_; }
+
+    /// Returns true if there are start() calls waiting for a slot.
+    bool hasWaiters() const noexcept { return !Lot::empty(); }
+
+  protected:
+    explicit BoundedNursery(size_t limit) : limit_(limit) {
+        CORRAL_ASSERT(limit > 0);
+    }
+
+  private:
+    using Nursery::startWithPriority;
+
+    /// The parent of tasks occupying a slot; frees the slot when
+    /// the task is done.
+    class SlotParent : public detail::TaskParent<void> {
+      public:
+        explicit SlotParent(BoundedNursery& nursery) : nursery_(nursery) {}
+
+        void storeSuccess() override {}
+        void storeException() override { nursery_.storeException(); }
+        void cancelled() override { nursery_.Nursery::cancelled(); }
+        Handle continuation(detail::BasePromise* promise) noexcept override {
+            nursery_.releaseSlot();
+            return nursery_.Nursery::continuation(promise);
+        }
+
+      private:
+        BoundedNursery& nursery_;
+    };
+
+    /// A start() call waiting for a slot.
+    class Waiter : public Lot::Parked {
+      public:
+        using Parked::Parked;
+
+      protected:
+        friend BoundedNursery;
+        bool granted_ = false;
+    };
+
+    bool hasFreeSlot() const noexcept {
+        return running_ < limit_ && Lot::empty();
+    }
+
+    template <class Callable, class... Args>
+    void startInSlot(Callable&& c, Args&&... args) {
+        try {
+            Task<void> task = makeTask<Callable, Args...>(
+                    std::forward<Callable>(c), std::forward<Args>(args)...);
+            addTask(std::move(task), &slotParent_, priority_).resume();
+        } catch (...) {
+            releaseSlot();
+            throw;
+        }
+    }
+
+    void releaseSlot() noexcept {
+        if (Lot::Parked* next = Lot::peek()) {
+            // Hand the slot over directly, so nobody can sneak in
+            // before the waiter gets to run.
+            static_cast<Waiter*>(next)->granted_ = true;
+            Lot::unparkOne();
+        } else {
+            --running_;
+        }
+    }
+
+  private:
+    size_t limit_;
+    size_t running_ = 0;
+    SlotParent slotParent_{*this};
+};
+
+template <class Callable, class... Args>
+class BoundedNursery::StartAwaitable : public BoundedNursery::Waiter {
+  public:
+    StartAwaitable(BoundedNursery& nursery, Callable&& c, Args&&... args)
+      : Waiter(nursery), callable_(std::move(c)), args_(std::move(args)...) {}
+
+    bool await_ready() const noexcept { return this->object().hasFreeSlot(); }
+
+    void await_suspend(Handle h) {
+        CORRAL_TRACE("    ...bounded nursery %p waiting for a slot",
+                     &this->object());
+        this->doSuspend(h);
+    }
+
+    void await_resume() {
+        BoundedNursery& nursery = this->object();
+        if (!this->granted_) {
+            ++nursery.running_;
+        }
+        std::apply(
+                [&](Args&... args) {
+                    nursery.startInSlot(std::move(callable_),
+                                        std::move(args)...);
+                },
+                args_);
+    }
+
+    using Waiter::await_cancel;
+
+  private:
+    [[no_unique_address]] Callable callable_;
+    [[no_unique_address]] std::tuple<Args...> args_;
+};
+
+struct BoundedNursery::Factory {
+    size_t limit;
+
+    template <class Callable> auto operator%(Callable&& c) {
+        return Nursery::Scope<Callable, BoundedNursery>(
+                std::forward<Callable>(c), limit);
+    }
+};
+
 } // namespace corral
@@ -0,0 +1,152 @@
+// This file is part of corral, a lightweight C++20 coroutine library.
+//
+// Copyright (c) 2024 Hudson River Trading LLC <opensource@hudson-trading.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// SPDX-License-Identifier: MIT
+
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "config.h"
+
+namespace corral {
+
+/// A snapshot of nursery counters, see Nursery::stats().
+///
+/// Apart from `live`, these are only collected if CORRAL_NURSERY_STATS
+/// is defined (see config.h); otherwise they stay zero.
+struct NurseryStats {
+    static constexpr const bool Enabled =
+#ifdef CORRAL_NURSERY_STATS
+            true;
+#else
+            false;
+#endif
+
+    /// Number of tasks currently running in the nursery.
+    size_t live = 0;
+
+    /// Number of tasks ever started in the nursery (including
+    /// the nursery body), and the largest number running at once.
+    uint64_t spawned = 0;
+    size_t peak = 0;
+
+    /// Number of tasks which exited with an unhandled exception,
+    /// or confirmed their cancellation.
+    uint64_t failed = 0;
+    uint64_t cancelled = 0;
+
+    /// Time spent in the nursery, summed over all its tasks
+    /// (including the ones still running). This is wall time from
+    /// the start of each task till its exit, so includes the time
+    /// the task spent suspended.
+    std::chrono::nanoseconds runTime{0};
+};
+
+namespace detail {
+
+#ifdef CORRAL_NURSERY_STATS
+
+class NurseryStatsCollector {
+    using Clock = std::chrono::steady_clock;
+
+  public:
+    /// Called before a task is added to a nursery running `live` tasks.
+    void taskStarted(size_t live) noexcept {
+        advance(live);
+        ++stats_.spawned;
+        stats_.peak = std::max(stats_.peak, live + 1);
+    }
+
+    /// Called before a task is removed from a nursery running `live`
+    /// tasks (this one included).
+    void taskFinished(size_t live) noexcept { advance(live); }
+
+    void taskFailed() noexcept { ++stats_.failed; }
+    void taskCancelled() noexcept { ++stats_.cancelled; }
+
+    NurseryStats get(size_t live) const noexcept {
+        NurseryStats ret = stats_;
+        ret.live = live;
+        ret.runTime += live * (Clock::now() - lastChange_);
+        return ret;
+    }
+
+    /// Formats the statistics for a footnote in a task tree dump.
+    /// The returned string is valid till the next call.
+    const char* describe(size_t live) const noexcept {
+        NurseryStats s = get(live);
+        snprintf(text_, sizeof(text_),
+                 "(live %zu, spawned %llu, peak %zu, failed %llu, "
+                 "cancelled %llu, run time %lld ms)",
+                 s.live, static_cast<unsigned long long>(s.spawned), s.peak,
+                 static_cast<unsigned long long>(s.failed),
+                 static_cast<unsigned long long>(s.cancelled),
+                 static_cast<long long>(
+                         std::chrono::duration_cast<std::chrono::milliseconds>(
+                                 s.runTime)
+                                 .count()));
+        return text_;
+    }
+
+  private:
+    /// Accounts for `live` tasks having run since the last change
+    /// of their number.
+    void advance(size_t live) noexcept {
+        Clock::time_point now = Clock::now();
+        stats_.runTime += live * (now - lastChange_);
+        lastChange_ = now;
+    }
+
+  private:
+    NurseryStats stats_;
+    Clock::time_point lastChange_ = Clock::now();
+    mutable char text_[128] = {};
+};
+
+#else
+
+class NurseryStatsCollector {
+  public:
+    void taskStarted(size_t) noexcept {}
+    void taskFinished(size_t) noexcept {}
+    void taskFailed() noexcept {}
+    void taskCancelled() noexcept {}
+
+    NurseryStats get(size_t live) const noexcept {
+        NurseryStats ret;
+        ret.live = live;
+        return ret;
+    }
+    const char* describe(size_t) const noexcept { return nullptr; }
+};
+
+#endif
+
+} // namespace detail
+} // namespace corral
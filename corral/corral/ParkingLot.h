@@ -49,8 +49,12 @@ class ParkingLot : public detail::ParkingLotImpl<ParkingLot> {
     /// Resumes the earliest parked task, if any.
     void unparkOne() { return Base::unparkOne(); }
 
-    /// Resumes all currently parked tasks.
+    /// Resumes all currently parked tasks. They are resumed
+    /// from the executor, not from within this call.
     void unparkAll() { return Base::unparkAll(); }
+
+    /// Same as above, but only for the `n` earliest parked tasks.
+    void unparkN(size_t n) { return Base::unparkN(n); }
 };
 
 } // namespace corral
@@ -0,0 +1,545 @@
+// This file is part of corral, a lightweight C++20 coroutine library.
+//
+// Copyright (c) 2024 Hudson River Trading LLC <opensource@hudson-trading.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// SPDX-License-Identifier: MIT
+
+
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include "Executor.h"
+#include "concepts.h"
+#include "config.h"
+#include "detail/IntrusiveList.h"
+
+namespace corral {
+
+/// Whether a ThreadChannel may be written to from several threads
+/// at once.
+enum class Producers { Single, Multiple };
+
+/// A bounded channel for passing objects between threads, e.g. from a
+/// thread doing blocking I/O to tasks running in an event loop, and back.
+///
+/// Objects are passed through a lock-free ring buffer of fixed capacity:
+/// trySend() and tryReceive() never lock, block or allocate. Any number
+/// of threads may send (only one at a time if `P` is Producers::Single,
+/// which saves an atomic read-modify-write per object), but only one
+/// thread at a time may receive.
+///
+/// Either end can wait, in one of two ways:
+///   - tasks running in an event loop `co_await send()` or `receive()`;
+///     the other end wakes them up through their executor's
+///     `Executor::runSoonFromThread()`, so the event loop must implement
+///     `EventLoopTraits<T>::post()` (see defs.h);
+///   - plain threads call sendBlocking() or receiveBlocking() instead.
+///
+/// Waiting is the slow path: it goes through a mutex, and as long as
+/// nobody waits, all the other end pays for it is a memory fence and
+/// an atomic load per object. Wakeups are coalesced: a waiter is woken
+/// up once, however many objects arrive in the meantime, and the
+/// executor batches wakeups arriving from several threads into a single
+/// event loop wakeup.
+///
+///    corral::ThreadChannel<Frame> frames(256);
+///    std::thread reader([&] {
+///        while (auto frame = readFrame(port)) {
+///            frames.sendBlocking(std::move(*frame));
+///        }
+///        frames.close();
+///    });
+///    while (std::optional<Frame> frame = co_await frames.receive()) {
+///        co_await handle(*frame);
+///    }
+///
+/// The channel must outlive both ends, and nobody may be waiting on it
+/// when it is destroyed.
+template <class T, Producers P = Producers::Multiple> class ThreadChannel {
+    class Waiter;
+    template <class Self> class AwaitableBase;
+    class ReceiveAwaitable;
+    template <class U> class SendAwaitable;
+    using Waiters = detail::IntrusiveList<Waiter>;
+
+  public:
+    /// Constructs a channel able to hold at least `capacity` objects
+    /// (rounded up to a power of two).
+    explicit ThreadChannel(size_t capacity)
+      : mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        cells_(new Cell[mask_ + 1]) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ThreadChannel(const ThreadChannel&) = delete;
+    ThreadChannel& operator=(const ThreadChannel&) = delete;
+
+    ~ThreadChannel() {
+        CORRAL_ASSERT(receivers_.empty() && senders_.empty() &&
+                      "ThreadChannel destroyed while being waited on");
+        while (tryReceive()) {
+        }
+    }
+
+    /// Returns the number of objects the channel can hold.
+    size_t capacity() const noexcept { return mask_ + 1; }
+
+    /// Returns true if close() has been called on this channel.
+    bool closed() const noexcept {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+    /// Closes the channel: no more objects can be sent, and waiting
+    /// senders get woken up with a `false` result. Receivers will still
+    /// receive whatever objects remain in the channel. May be called
+    /// from any thread.
+    void close() {
+        closed_.store(true, std::memory_order_seq_cst);
+        wake(receivers_, ReceiverWaiting);
+        wake(senders_, SendersWaiting);
+    }
+
+    //
+    // Producer side
+    //
+
+    /// Delivers `value` into the channel, unless it is full or closed;
+    /// returns false (and leaves `value` untouched) if so.
+    template <class U> bool trySend(U&& value) {
+        if (closed()) {
+            return false;
+        }
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+            if (diff < 0) {
+                return false; // full
+            } else if constexpr (P == Producers::Single) {
+                tail_.store(pos + 1, std::memory_order_relaxed);
+                break;
+            } else if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+                    break;
+                }
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        new (cell->object()) T(std::forward<U>(value));
+        cell->seq.store(pos + 1, std::memory_order_release);
+        wake(receivers_, ReceiverWaiting);
+        return true;
+    }
+
+    /// Returns an awaitable which delivers `value` into the channel,
+    /// waiting for space if it is full. Evaluates to false if the
+    /// channel is closed. Must be awaited from a task whose event loop
+    /// implements `EventLoopTraits<T>::post()`.
+    template <class U> Awaitable<bool> auto send(U&& value) {
+        return SendAwaitable<U>(*this, std::forward<U>(value));
+    }
+
+    /// Delivers `value` into the channel, blocking the calling thread
+    /// until there is space for it. Returns false if the channel
+    /// is closed. Must not be called from an event loop thread.
+    template <class U> bool sendBlocking(U&& value) {
+        Waiter w;
+        for (;;) {
+            if (trySend(std::forward<U>(value))) {
+                return true;
+            } else if (closed()) {
+                return false;
+            } else if (parkSender(w)) {
+                block(w);
+            }
+        }
+    }
+
+    //
+    // Consumer side
+    //
+
+    /// Retrieves an object from the channel, or returns std::nullopt
+    /// if none is immediately available.
+    std::optional<T> tryReceive() {
+        std::optional<T> ret;
+        Cell& cell = cells_[head_ & mask_];
+        if (cell.seq.load(std::memory_order_acquire) != head_ + 1) {
+            return ret;
+        }
+        T* obj = cell.object();
+        ret.emplace(std::move(*obj));
+        obj->~T();
+        cell.seq.store(head_ + mask_ + 1, std::memory_order_release);
+        ++head_;
+        wake(senders_, SendersWaiting);
+        return ret;
+    }
+
+    /// Returns an awaitable which retrieves an object from the channel,
+    /// waiting for one if the channel is empty. Evaluates to std::nullopt
+    /// once the channel is closed and has no objects left.
+    /// Must be awaited from a task whose event loop implements
+    /// `EventLoopTraits<T>::post()`.
+    Awaitable<std::optional<T>> auto receive() {
+        return ReceiveAwaitable(*this);
+    }
+
+    /// Retrieves an object from the channel, blocking the calling thread
+    /// until one is available. Returns std::nullopt once the channel is
+    /// closed and has no objects left. Must not be called from an event
+    /// loop thread.
+    std::optional<T> receiveBlocking() {
+        Waiter w;
+        for (;;) {
+            if (auto ret = tryReceive()) {
+                return ret;
+            } else if (closed()) {
+                return tryReceive();
+            } else if (parkReceiver(w)) {
+                block(w);
+            }
+        }
+    }
+
+  private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* object() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    static constexpr uint32_t ReceiverWaiting = 1;
+    static constexpr uint32_t SendersWaiting = 2;
+
+    /// Whether a receiver would find something to do.
+    bool readable() const noexcept {
+        const Cell& cell = cells_[head_ & mask_];
+        return cell.seq.load(std::memory_order_acquire) == head_ + 1 ||
+               closed();
+    }
+
+    /// Whether a sender would find something to do.
+    bool writable() const noexcept {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        const Cell& cell = cells_[pos & mask_];
+        size_t seq = cell.seq.load(std::memory_order_acquire);
+        return static_cast<std::ptrdiff_t>(seq - pos) >= 0 || closed();
+    }
+
+    bool parkReceiver(Waiter& w) {
+        return park(receivers_, ReceiverWaiting, w,
+                    [this] { return readable(); });
+    }
+    bool parkSender(Waiter& w) {
+        return park(senders_, SendersWaiting, w,
+                    [this] { return writable(); });
+    }
+
+    /// Adds `w` to `list`, unless `ready()` turns out to hold once
+    /// the other end has been told about it. Returns true if `w` has
+    /// been parked; it will get woken up then.
+    template <class Ready>
+    bool park(Waiters& list, uint32_t bit, Waiter& w, Ready ready) {
+        {
+            std::lock_guard lk(mutex_);
+            CORRAL_ASSERT((&list != &receivers_ || list.empty()) &&
+                          "ThreadChannel only supports one receiver at a time");
+            w.woken_ = false;
+            list.push_back(w);
+            waiting_.fetch_or(bit, std::memory_order_relaxed);
+        }
+        // Pairs with the fence in wake(): either we see what the other
+        // end has just done, or it sees `bit` set.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready()) {
+            return true;
+        }
+        return !unpark(list, bit, w);
+    }
+
+    /// Removes `w` from `list`; returns false if it is too late for that,
+    /// since a wakeup is on its way already.
+    bool unpark(Waiters& list, uint32_t bit, Waiter& w) {
+        std::lock_guard lk(mutex_);
+        if (w.woken_) {
+            return false;
+        }
+        list.erase(w);
+        if (list.empty()) {
+            waiting_.fetch_and(~bit, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    /// Wakes up everyone in `list`. Called after every operation,
+    /// so the common case of nobody waiting must be cheap.
+    void wake(Waiters& list, uint32_t bit) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!(waiting_.load(std::memory_order_relaxed) & bit)) [[likely]] {
+            return;
+        }
+
+        Waiters remote;
+        bool blocked = false;
+        {
+            std::lock_guard lk(mutex_);
+            while (!list.empty()) {
+                Waiter& w = list.front();
+                list.pop_front();
+                w.woken_ = true;
+                if (w.executor_) {
+                    remote.push_back(w);
+                } else {
+                    blocked = true;
+                }
+            }
+            waiting_.fetch_and(~bit, std::memory_order_relaxed);
+        }
+        if (blocked) {
+            cv_.notify_all();
+        }
+        while (!remote.empty()) {
+            // Unlink before submitting: the waiter may be gone as soon
+            // as its executor has picked it up.
+            Waiter& w = remote.front();
+            remote.pop_front();
+            w.executor_->runSoonFromThread(w.remote_);
+        }
+    }
+
+    /// Blocks the calling thread until parked `w` gets woken up.
+    void block(Waiter& w) {
+        std::unique_lock lk(mutex_);
+        cv_.wait(lk, [&] { return w.woken_; });
+    }
+
+  private:
+    /// Written by producers; alone in its cache line, as is head_.
+    alignas(64) std::atomic<size_t> tail_{0};
+
+    /// Only accessed by the (single) consumer.
+    alignas(64) size_t head_ = 0;
+
+    alignas(64) const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+    std::atomic<bool> closed_{false};
+
+    /// Bits telling the other end that someone waits to be woken up,
+    /// so it only needs to lock mutex_ if it does.
+    std::atomic<uint32_t> waiting_{0};
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    Waiters receivers_;
+    Waiters senders_;
+};
+
+
+//
+// Implementation
+//
+
+/// A thread or task waiting on a ThreadChannel.
+template <class T, Producers P>
+class ThreadChannel<T, P>::Waiter
+  : public detail::IntrusiveListItem<Waiter> {
+  public:
+    /// A blocked thread.
+    Waiter() : remote_(+[](Waiter*) noexcept {}, this) {}
+
+  protected:
+    /// A task; `onWoken(self)` will be called on its executor
+    /// whenever it gets woken up.
+    template <class Self>
+    Waiter(void (*onWoken)(Self*) noexcept, Self* self)
+      : remote_(onWoken, self) {}
+
+    friend ThreadChannel;
+
+    /// Null for blocked threads.
+    Executor* executor_ = nullptr;
+    Executor::RemoteTask remote_;
+
+    /// Protected by mutex_.
+    bool woken_ = false;
+};
+
+/// Common part of receive() and send(): `Self::attempt()` is retried
+/// whenever the other end makes progress, until it succeeds.
+template <class T, Producers P>
+template <class Self>
+class ThreadChannel<T, P>::AwaitableBase : protected Waiter {
+  public:
+    void await_set_executor(Executor* ex) noexcept { this->executor_ = ex; }
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(Handle h) {
+        handle_ = h;
+        return !tryComplete();
+    }
+    bool await_cancel(Handle) noexcept {
+        cancelled_ = true;
+        return self().unpark();
+    }
+    bool await_must_resume() const noexcept { return done_; }
+
+  protected:
+    explicit AwaitableBase(ThreadChannel& channel)
+      : Waiter(&AwaitableBase::onWoken, this), channel_(channel) {}
+
+    AwaitableBase(AwaitableBase&& rhs) : AwaitableBase(rhs.channel_) {
+        CORRAL_ASSERT(!rhs.handle_ && "cannot move a pending ThreadChannel op");
+    }
+
+    void checkException() {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+    }
+
+  private:
+    Self& self() { return static_cast<Self&>(*this); }
+
+    /// Returns true once `attempt()` has succeeded, false if parked.
+    bool tryComplete() {
+        do {
+            if (self().attempt()) {
+                done_ = true;
+                return true;
+            }
+        } while (!self().park());
+        return false;
+    }
+
+    static void onWoken(AwaitableBase* base) noexcept {
+        try {
+            if (base->cancelled_) {
+                // Too late to unpark(); give it one last try
+                // so nothing gets lost.
+                base->done_ = base->self().attempt();
+            } else if (!base->tryComplete()) {
+                return;
+            }
+        } catch (...) {
+            base->exception_ = std::current_exception();
+            base->done_ = true;
+        }
+        base->handle_.resume();
+    }
+
+  protected:
+    ThreadChannel& channel_;
+
+  private:
+    Handle handle_;
+    std::exception_ptr exception_;
+    bool cancelled_ = false;
+    bool done_ = false;
+};
+
+template <class T, Producers P>
+class ThreadChannel<T, P>::ReceiveAwaitable
+  : public AwaitableBase<ReceiveAwaitable> {
+    using Base = AwaitableBase<ReceiveAwaitable>;
+
+  public:
+    explicit ReceiveAwaitable(ThreadChannel& channel) : Base(channel) {}
+
+    std::optional<T> await_resume() {
+        this->checkException();
+        return std::move(result_);
+    }
+
+  private:
+    friend Base;
+
+    bool attempt() {
+        result_ = this->channel_.tryReceive();
+        if (!result_ && this->channel_.closed()) {
+            // Objects sent before close() might have arrived
+            // after tryReceive() has checked
+            result_ = this->channel_.tryReceive();
+            return true;
+        }
+        return result_.has_value();
+    }
+    bool park() { return this->channel_.parkReceiver(*this); }
+    bool unpark() {
+        return this->channel_.unpark(this->channel_.receivers_,
+                                     ReceiverWaiting, *this);
+    }
+
+    std::optional<T> result_;
+};
+
+template <class T, Producers P>
+template <class U>
+class ThreadChannel<T, P>::SendAwaitable
+  : public AwaitableBase<SendAwaitable<U>> {
+    using Base = AwaitableBase<SendAwaitable<U>>;
+
+  public:
+    SendAwaitable(ThreadChannel& channel, U&& value)
+      : Base(channel), value_(std::forward<U>(value)) {}
+
+    SendAwaitable(SendAwaitable&& rhs)
+      : Base(std::move(rhs)), value_(std::forward<U>(rhs.value_)) {}
+
+    bool await_resume() {
+        this->checkException();
+        return sent_;
+    }
+
+  private:
+    friend Base;
+
+    bool attempt() {
+        sent_ = this->channel_.trySend(std::forward<U>(value_));
+        return sent_ || this->channel_.closed();
+    }
+    bool park() { return this->channel_.parkSender(*this); }
+    bool unpark() {
+        return this->channel_.unpark(this->channel_.senders_, SendersWaiting,
+                                     *this);
+    }
+
+    U&& value_;
+    bool sent_ = false;
+};
+
+} // namespace corral
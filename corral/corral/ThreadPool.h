@@ -0,0 +1,532 @@
+// This file is part of corral, a lightweight C++20 coroutine library.
+//
+// Copyright (c) 2024 Hudson River Trading LLC <opensource@hudson-trading.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "Event.h"
+#include "Nursery.h"
+#include "Task.h"
+#include "wait.h"
+
+namespace corral {
+
+/// A pool of worker threads to offload work from an event loop onto.
+///
+/// corral tasks are strictly single-threaded, and the pool does not change
+/// that: each worker thread is an async universe of its own, with its own
+/// event loop (ThreadPool::Worker) and executor. What the pool provides is
+/// an awaitable which runs an async function on one of the workers and
+/// suspends the calling task until it is done:
+///
+///    corral::ThreadPool pool(4);
+///    QByteArray digest = co_await pool.run(sha256, std::move(image));
+///
+/// or, to place a child task of a nursery on a worker,
+///
+///    pool.start(nursery, sha256, std::move(image));
+///
+/// Each worker has its own deque of pending jobs. Jobs submitted from the
+/// home event loop are distributed round-robin; a worker whose deque runs
+/// dry steals from the back of its siblings' deques, so a burst of jobs
+/// spreads over all cores.
+///
+/// Cancellation and exceptions are structured the same way as for any
+/// other awaitable: cancelling the awaiting task forwards the request to
+/// the worker, and the awaiting task resumes only once the job has
+/// actually finished or been cancelled. A job still waiting in a queue is
+/// taken off it instead, and the awaiting task is cancelled right away.
+/// An exception escaping the job is rethrown in the awaiting task.
+///
+/// The callable and its arguments are moved into the awaitable and are
+/// used on the worker thread only; they must not refer to anything that
+/// belongs to the home thread. The worker event loop does no I/O, so a job
+/// may only wait on corral primitives that it owns itself (it may well
+/// spawn a nursery with several tasks and synchronize them, though).
+///
+/// Completed jobs are handed back to the awaiting task's executor through
+/// `Executor::runSoonFromThread()`, so its event loop must implement
+/// `EventLoopTraits<T>::post()` (see defs.h). Each worker uses
+/// the thread-local `Executor::current()`, so CORRAL_THREAD_LOCAL must not
+/// be redefined to `static` in programs using ThreadPool.
+///
+/// All jobs must have completed before the pool is destroyed.
+class ThreadPool {
+    class JobBase;
+    template <class Callable, class... Args> class Job;
+
+  public:
+    class Worker;
+
+    explicit ThreadPool(size_t threads = defaultThreads()) {
+        CORRAL_ASSERT(threads > 0);
+        startWorkers(threads);
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    /// Returns the number of worker threads.
+    size_t size() const noexcept { return workers_.size(); }
+
+    /// Returns an awaitable which runs `co_await std::invoke(c, args...)`
+    /// on a worker thread and evaluates to its result.
+    template <class Callable, class... Args>
+        requires(Awaitable<std::invoke_result_t<Callable, Args...>>)
+    auto run(Callable c, Args... args) {
+        return Job<Callable, Args...>(*this, std::move(c), std::move(args)...);
+    }
+
+    /// Starts a task in `nursery` which runs
+    /// `co_await std::invoke(c, args...)` on a worker thread.
+    /// The nursery waits for the job, gets its exception (if any),
+    /// and cancels it the same way as for a task running on its own
+    /// thread.
+    template <class Callable, class... Args>
+        requires(Awaitable<std::invoke_result_t<Callable, Args...>>)
+    void start(Nursery& nursery, Callable c, Args... args) {
+        nursery.start(
+                [this](Callable cc, Args... aa) {
+                    return run(std::move(cc), std::move(aa)...);
+                },
+                std::move(c), std::move(args)...);
+    }
+
+  private:
+    static size_t defaultThreads() noexcept {
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    void startWorkers(size_t threads);
+
+    /// Called on the home thread when a job gets awaited.
+    void submit(JobBase* job);
+
+    /// Called on a worker thread when a job has finished.
+    void complete(JobBase* job);
+
+    /// Returns a job taken from some worker other than `self`, or nullptr.
+    JobBase* steal(Worker& self);
+
+    /// Removes a job which has not been started yet from whichever
+    /// queue it is in; returns false if it is no longer queued.
+    bool withdraw(JobBase* job);
+
+    /// Wakes up sleeping workers.
+    void notify(bool all);
+
+  private:
+    std::vector<std::unique_ptr<Worker>> workers_;
+    size_t nextWorker_ = 0;
+
+    /// Number of submitted jobs not yet handed back; home thread only.
+    size_t inFlight_ = 0;
+
+    /// Sleeping workers wait for `generation_` to change.
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    size_t generation_ = 0;
+    bool stopping_ = false;
+};
+
+
+//
+// Implementation
+//
+
+/// The part of a job that does not depend on the callable.
+class ThreadPool::JobBase {
+  public:
+    JobBase(JobBase&&) = delete;
+
+  protected:
+    explicit JobBase(ThreadPool& pool) : pool_(pool) {}
+    ~JobBase() = default;
+
+    /// Runs the callable, storing its result. Returns false if it
+    /// got cancelled.
+    virtual Task<bool> body() = 0;
+
+    /// Requests cancellation from the home thread. Returns true if
+    /// the job has not been started and got withdrawn, so that it will
+    /// not be handed back.
+    bool requestCancel();
+
+    bool succeeded() const noexcept { return succeeded_; }
+
+  protected:
+    ThreadPool& pool_;
+    Executor* executor_ = nullptr;
+    Handle parent_;
+    std::exception_ptr exception_;
+
+    /// Triggered on the worker thread to cancel body().
+    Event cancelEvent_;
+
+  private:
+    friend ThreadPool;
+    friend Worker;
+
+    Task<void> execute();
+
+    /// Resumes the awaiting task; runs on the home thread.
+    void handBack() noexcept {
+        --pool_.inFlight_;
+        std::exchange(parent_, nullptr).resume();
+    }
+
+    Executor::RemoteTask remoteTask_{
+            +[](JobBase* self) noexcept { self->handBack(); }, this};
+
+    // Protected by mutex_, as those are touched from both sides
+    std::mutex mutex_;
+    Worker* worker_ = nullptr;
+    bool cancelRequested_ = false;
+
+    bool succeeded_ = false;
+};
+
+/// The event loop of a worker thread. Other than running the jobs
+/// it is handed, it only ever sleeps.
+class ThreadPool::Worker {
+  public:
+    Worker(ThreadPool& pool, size_t index) : pool_(pool), index_(index) {}
+
+  private:
+    friend ThreadPool;
+    friend JobBase;
+    friend struct EventLoopTraits<Worker>;
+
+    void main();
+    void loop();
+
+    /// Runs one pending cancellation or job, if any; returns false if
+    /// there was nothing to do.
+    bool runOne();
+
+    void startJob(JobBase* job);
+
+    JobBase* popJob() {
+        std::lock_guard lk(mutex_);
+        if (jobs_.empty()) {
+            return nullptr;
+        }
+        JobBase* job = jobs_.front();
+        jobs_.pop_front();
+        return job;
+    }
+
+    JobBase* stealJob() {
+        std::lock_guard lk(mutex_);
+        if (jobs_.empty()) {
+            return nullptr;
+        }
+        JobBase* job = jobs_.back();
+        jobs_.pop_back();
+        return job;
+    }
+
+    void postCancel(JobBase* job) {
+        {
+            std::lock_guard lk(mutex_);
+            cancels_.push_back(job);
+        }
+        pool_.notify(/*all = */ true);
+    }
+
+  private:
+    ThreadPool& pool_;
+    size_t index_;
+    std::thread thread_;
+    Nursery* nursery_ = nullptr;
+    bool stopped_ = false;
+
+    std::mutex mutex_;
+    std::deque<JobBase*> jobs_;
+    std::vector<JobBase*> cancels_;
+};
+
+template <> struct EventLoopTraits<ThreadPool::Worker> {
+    static EventLoopID eventLoopID(ThreadPool::Worker& w) {
+        return EventLoopID(&w);
+    }
+    static void run(ThreadPool::Worker& w) { w.loop(); }
+    static void stop(ThreadPool::Worker& w) { w.stopped_ = true; }
+};
+
+/// The awaitable returned by ThreadPool::run().
+template <class Callable, class... Args>
+class ThreadPool::Job : public ThreadPool::JobBase {
+    using Ret = detail::AwaitableReturnType<
+            std::invoke_result_t<Callable, Args...>>;
+    static_assert(!std::is_reference_v<Ret>,
+                  "ThreadPool jobs cannot return references");
+
+  public:
+    Job(ThreadPool& pool, Callable c, Args... args)
+      : JobBase(pool), callable_(std::move(c)), args_(std::move(args)...) {}
+
+    Job(Job&& rhs)
+      : JobBase(rhs.pool_),
+        callable_(std::move(rhs.callable_)),
+        args_(std::move(rhs.args_)) {
+        CORRAL_ASSERT(!rhs.parent_ && "cannot move a running job");
+    }
+
+    void await_set_executor(Executor* ex) noexcept { executor_ = ex; }
+    bool await_ready() const noexcept { return false; }
+    auto await_early_cancel() noexcept { return std::true_type{}; }
+    void await_suspend(Handle h) {
+        parent_ = h;
+        pool_.submit(this);
+    }
+    bool await_cancel(Handle) noexcept { return requestCancel(); }
+    bool await_must_resume() const noexcept {
+        return exception_ || succeeded();
+    }
+    auto await_resume() {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+        if constexpr (!std::is_same_v<Ret, detail::Void>) {
+            return std::move(*result_);
+        }
+    }
+    void await_introspect(detail::TaskTreeCollector& c) const noexcept {
+        c.node("ThreadPool::run");
+    }
+
+  private:
+    Task<bool> body() override {
+        auto result = std::get<0>(co_await anyOf(
+                std::apply(std::move(callable_), std::move(args_)),
+                cancelEvent_));
+        if (!result) {
+            co_return false;
+        }
+        result_.emplace(std::move(*result));
+        co_return true;
+    }
+
+  private:
+    Callable callable_;
+    std::tuple<Args...> args_;
+    std::optional<Ret> result_;
+};
+
+inline void ThreadPool::startWorkers(size_t threads) {
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>(*this, i));
+    }
+    for (auto& w : workers_) {
+        w->thread_ = std::thread([w = w.get()] { w->main(); });
+    }
+}
+
+inline ThreadPool::~ThreadPool() {
+    CORRAL_ASSERT(inFlight_ == 0 && "ThreadPool destroyed with jobs running");
+    {
+        std::lock_guard lk(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_all();
+    for (auto& w : workers_) {
+        w->thread_.join();
+    }
+}
+
+inline void ThreadPool::submit(JobBase* job) {
+    ++inFlight_;
+    Worker& w = *workers_[nextWorker_++ % workers_.size()];
+    {
+        std::lock_guard lk(w.mutex_);
+        w.jobs_.push_back(job);
+    }
+    notify(/*all = */ false);
+}
+
+inline void ThreadPool::complete(JobBase* job) {
+    job->executor_->runSoonFromThread(job->remoteTask_);
+}
+
+inline ThreadPool::JobBase* ThreadPool::steal(Worker& self) {
+    size_t n = workers_.size();
+    for (size_t i = 1; i < n; ++i) {
+        Worker& victim = *workers_[(self.index_ + i) % n];
+        if (JobBase* job = victim.stealJob()) {
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+inline bool ThreadPool::withdraw(JobBase* job) {
+    for (auto& w : workers_) {
+        std::lock_guard lk(w->mutex_);
+        auto it = std::find(w->jobs_.begin(), w->jobs_.end(), job);
+        if (it != w->jobs_.end()) {
+            w->jobs_.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void ThreadPool::notify(bool all) {
+    {
+        std::lock_guard lk(mutex_);
+        ++generation_;
+    }
+    if (all) {
+        wakeup_.notify_all();
+    } else {
+        wakeup_.notify_one();
+    }
+}
+
+inline bool ThreadPool::JobBase::requestCancel() {
+    std::lock_guard lk(mutex_);
+    cancelRequested_ = true;
+    if (worker_) {
+        worker_->postCancel(this);
+        return false;
+    }
+    // Not started yet. If no worker has picked it up either, there is
+    // no need to wait for one to do so (behind whatever is queued
+    // ahead of it) only to learn that it is cancelled.
+    if (pool_.withdraw(this)) {
+        --pool_.inFlight_;
+        parent_ = nullptr;
+        return true;
+    }
+    // Otherwise startJob() will see cancelRequested_ and hand it back
+    return false;
+}
+
+inline Task<void> ThreadPool::JobBase::execute() {
+    try {
+        succeeded_ = co_await body();
+    } catch (...) {
+        exception_ = std::current_exception();
+    }
+
+    // Make sure no cancellation request for this job is left behind;
+    // the job is about to be handed back and may get destroyed.
+    Worker* worker;
+    {
+        std::lock_guard lk(mutex_);
+        worker = std::exchange(worker_, nullptr);
+    }
+    {
+        std::lock_guard lk(worker->mutex_);
+        std::erase(worker->cancels_, this);
+    }
+    pool_.complete(this);
+}
+
+inline void ThreadPool::Worker::main() {
+    UnsafeNursery nursery(*this);
+    nursery_ = &nursery;
+    EventLoopTraits<Worker>::run(*this);
+    nursery_ = nullptr;
+}
+
+inline void ThreadPool::Worker::loop() {
+    while (!stopped_) {
+        size_t seen;
+        {
+            std::lock_guard lk(pool_.mutex_);
+            if (pool_.stopping_) {
+                return;
+            }
+            seen = pool_.generation_;
+        }
+        if (runOne()) {
+            continue;
+        }
+        std::unique_lock lk(pool_.mutex_);
+        pool_.wakeup_.wait(lk, [&] {
+            return pool_.generation_ != seen || pool_.stopping_;
+        });
+    }
+}
+
+inline bool ThreadPool::Worker::runOne() {
+    // Cancellations are handled one at a time: cancelling a job runs
+    // the executor, which may complete (and thus release) other jobs
+    // whose cancellation is still pending.
+    JobBase* cancelled = nullptr;
+    {
+        std::lock_guard lk(mutex_);
+        if (!cancels_.empty()) {
+            cancelled = cancels_.front();
+            cancels_.erase(cancels_.begin());
+        }
+    }
+    if (cancelled) {
+        cancelled->cancelEvent_.trigger();
+        return true;
+    }
+
+    JobBase* job = popJob();
+    if (!job) {
+        job = pool_.steal(*this);
+    }
+    if (job) {
+        startJob(job);
+        return true;
+    }
+    return false;
+}
+
+inline void ThreadPool::Worker::startJob(JobBase* job) {
+    bool cancelled;
+    {
+        std::lock_guard lk(job->mutex_);
+        cancelled = job->cancelRequested_;
+        if (!cancelled) {
+            job->worker_ = this;
+        }
+    }
+    if (cancelled) {
+        // Cancelled before it had a chance to start
+        pool_.complete(job);
+        return;
+    }
+    nursery_->start([](JobBase* j) { return j->execute(); }, job);
+}
+
+} // namespace corral
@@ -261,6 +261,12 @@ template <> struct EventLoopTraits<boost::asio::io_service> {
     }
 
     static void stop(boost::asio::io_service& io) { io.stop(); }
+
+    static void post(boost::asio::io_service& io,
+                     void (*fn)(void*),
+                     void* arg) {
+        boost::asio::post(io, [fn, arg] { fn(arg); });
+    }
 };
 
 } // namespace corral
@@ -92,6 +92,33 @@ template <class Promise> using CoroutineHandle = std::coroutine_handle<Promise>;
 // diagnosing bugs in corral itself.
 /* #define CORRAL_AWAITABLE_STATE_DEBUG */
 
+// You may define CORRAL_EXECUTOR_STATS to make executors collect
+// scheduling statistics (see Executor::stats() and corral::executorStats()).
+// This reads the clock around every executor callback, so is best left
+// off unless you actually export these. When undefined, statistics
+// collection compiles away entirely.
+/* #define CORRAL_EXECUTOR_STATS */
+
+// You may define CORRAL_POOLED_FRAMES to allocate coroutine frames of
+// corral tasks from a per-thread pool of size-class free lists instead
+// of the global allocator (see FramePool.h). This helps programs which
+// start many short-lived tasks. Note that the pool keeps freed memory
+// around (4MiB per thread by default).
+/* #define CORRAL_POOLED_FRAMES */
+
+// You may define CORRAL_FRAME_PROFILER to record, for each coroutine
+// function, the size of its frames and how many of them are (and have
+// been) allocated; see corral::frameProfile(). This costs a 16-byte
+// header per frame and a mutex-protected lookup per task started,
+// so is meant for debugging builds.
+/* #define CORRAL_FRAME_PROFILER */
+
+// You may define CORRAL_NURSERY_STATS to make nurseries count the tasks
+// they start, and how these end (see Nursery::stats()); the counters
+// also show up in task tree dumps. This reads the clock whenever a task
+// starts or exits.
+/* #define CORRAL_NURSERY_STATS */
+
 // You may define CORRAL_ENTER_ASYNC_UNIVERSE to provide an expression
 // which will be evaluated upon entering an "async universe" (i.e. when
 // corral::run() is entered, or when UnsafeNursery is constructed),
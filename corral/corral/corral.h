@@ -35,6 +35,8 @@
 #include "wait.h"
 
 // Synchronization primitives
+#include "AsyncMutex.h"
+#include "BroadcastChannel.h"
 #include "CBPortal.h"
 #include "Channel.h"
 #include "Event.h"
@@ -43,6 +43,16 @@ class EventLoopID {
     constexpr auto operator<=>(const EventLoopID& other) const = default;
 };
 
+/// Scheduling priority of a task, see Executor.
+/// Tasks inherit the priority of whoever started them; use
+/// `Nursery::setPriority()` or `Nursery::startWithPriority()`
+/// to change it.
+enum class Priority : unsigned char {
+    Normal = 0, // must be zero, so that zero-initialized things get it
+    High,
+    Background,
+};
+
 
 /// Specialize this to adapt corral to a new eventLoop type.
 template <class T, class = void> struct EventLoopTraits {
@@ -65,6 +75,12 @@ template <class T, class = void> struct EventLoopTraits {
     /// if no suitable implementation is available, may always return false,
     /// or leave undefined for the same effect.
     static bool isRunning(T&) noexcept;
+
+    /// Arranges for `fn(arg)` to be called from within the event loop
+    /// soon. Unlike the other functions here, this one may be called
+    /// from any thread. Needed for Executor::runSoonFromThread() (and
+    /// thus ThreadPool); may be left undefined otherwise.
+    static void post(T&, void (*fn)(void*), void* arg);
 };
 
 
@@ -23,6 +23,9 @@
 // SPDX-License-Identifier: MIT
 
 #pragma once
+#include <iterator>
+#include <type_traits>
+#include <utility>
 
 namespace corral::detail {
 
@@ -130,6 +133,20 @@ template <class T> class IntrusiveList : private IntrusiveListItem<T> {
 
     void erase(T& item) { item.unlink(); }
 
+    /// Moves all items of `other` to the end of this list.
+    void splice(IntrusiveList& other) {
+        if (other.empty()) {
+            return;
+        }
+        IntrusiveListItem<T>* first = other.next_;
+        IntrusiveListItem<T>* last = other.prev_;
+        first->prev_ = this->prev_;
+        last->next_ = this;
+        this->prev_->next_ = first;
+        this->prev_ = last;
+        other.next_ = other.prev_ = &other;
+    }
+
     void push_back(T& item) {
         item.unlink();
         item.next_ = this;
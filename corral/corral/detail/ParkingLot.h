@@ -23,6 +23,10 @@
 // SPDX-License-Identifier: MIT
 
 #pragma once
+#include <limits>
+#include <memory>
+
+#include "../Executor.h"
 #include "IntrusiveList.h"
 #include "utility.h"
 
@@ -41,6 +45,8 @@ template <class Self> class ParkingLotImpl {
       public:
         explicit Parked(Self& object) : object_(object) {}
 
+        void await_set_executor(Executor* ex) noexcept { executor_ = ex; }
+
         auto await_cancel(Handle) noexcept {
             this->unlink();
             handle_ = std::noop_coroutine();
@@ -63,6 +69,7 @@ template <class Self> class ParkingLotImpl {
       private:
         Self& object_;
         Handle handle_;
+        Executor* executor_ = nullptr;
         friend class ParkingLotImpl<Self>;
     };
     friend class Parked;
@@ -87,10 +94,44 @@ template <class Self> class ParkingLotImpl {
     }
 
     /// Wake all waiters that were waiting when the call to unparkAll() began.
-    void unparkAll() {
-        auto parked = std::move(parked_);
-        while (!parked.empty()) {
-            parked.front().unpark();
+    ///
+    /// Unlike unparkOne(), this does not resume anything from within
+    /// the caller: the waiters are handed over to their executor in one
+    /// go (one batch per executor, should they differ), and resumed
+    /// from a single executor callback. This keeps the caller's stack
+    /// shallow however many tasks are waiting (think Event::trigger()
+    /// or Channel::close()). A waiter cancelled before its batch runs
+    /// is cancelled as usual, rather than woken.
+    void unparkAll() { unparkN(std::numeric_limits<size_t>::max()); }
+
+    /// Same as above, but for the `n` oldest waiters only.
+    void unparkN(size_t n) {
+        IntrusiveList<Parked> woken;
+        if (n == std::numeric_limits<size_t>::max()) {
+            woken.splice(parked_);
+        } else {
+            for (; n != 0 && !parked_.empty(); --n) {
+                woken.push_back(parked_.front());
+            }
+        }
+
+        while (!woken.empty()) {
+            Executor* ex = woken.front().executor_;
+            Batch* batch = Batch::get();
+            for (auto it = woken.begin(); it != woken.end();) {
+                Parked& p = *it++;
+                if (p.executor_ == ex) {
+                    batch->parked.push_back(p);
+                }
+            }
+
+            if (ex) {
+                ex->runSoon(&Batch::run, batch);
+            } else {
+                // Awaited from outside of corral tasks, so there is no
+                // executor to defer to.
+                Batch::run(batch);
+            }
         }
     }
 
@@ -99,6 +140,39 @@ template <class Self> class ParkingLotImpl {
     bool empty() const { return parked_.empty(); }
 
   private:
+    /// Waiters woken by unparkAll() or unparkN(), still to be resumed.
+    /// Waiters cancelled in the meantime unlink themselves as usual.
+    /// Batches are not tied to the parking lot, which may well be gone
+    /// by the time the executor gets to them.
+    struct Batch {
+        IntrusiveList<Parked> parked;
+
+        static Batch* get() {
+            if (Batch* batch = spare().release()) {
+                return batch;
+            }
+            return new Batch;
+        }
+
+        static void run(Batch* batch) noexcept {
+            while (!batch->parked.empty()) {
+                batch->parked.front().unpark();
+            }
+            // Keep one around, so waking does not allocate
+            // in the common case
+            if (!spare()) {
+                spare().reset(batch);
+            } else {
+                delete batch;
+            }
+        }
+
+        static std::unique_ptr<Batch>& spare() noexcept {
+            CORRAL_THREAD_LOCAL std::unique_ptr<Batch> batch;
+            return batch;
+        }
+    };
+
     IntrusiveList<Parked> parked_;
 };
 
@@ -26,11 +26,13 @@
 #include <stddef.h>
 
 #include "../Executor.h"
+#include "../FrameProfiler.h"
 #include "../config.h"
 #include "../defs.h"
 #include "../utility.h"
 #include "ABI.h"
 #include "IntrusiveList.h"
+#include "PointerBits.h"
 #include "ScopeGuard.h"
 #include "frames.h"
 #include "introspect.h"
@@ -154,7 +156,34 @@ class BasePromise : private TaskFrame, public IntrusiveListItem<BasePromise> {
     BasePromise(BasePromise&&) = delete;
     BasePromise& operator=(BasePromise&&) = delete;
 
-    void setExecutor(Executor* ex) { executor_ = ex; }
+#if defined(CORRAL_FRAME_PROFILER)
+    // Picked up both by coroutine frames of any derived promise type
+    // and by `new`/`delete` of stub promises (see makeStub()).
+    static void* operator new(size_t size) {
+        return FrameProfiler::allocate(size);
+    }
+    static void operator delete(void* ptr, size_t size) noexcept {
+        FrameProfiler::deallocate(ptr, size);
+    }
+#elif defined(CORRAL_POOLED_FRAMES)
+    static void* operator new(size_t size) {
+        return allocateFrameMemory(size);
+    }
+    static void operator delete(void* ptr, size_t size) noexcept {
+        deallocateFrameMemory(ptr, size);
+    }
+#endif
+
+    /// Sets the executor the task will run on. The task inherits
+    /// the priority of whatever task is currently running there.
+    void setExecutor(Executor* ex) {
+        setExecutor(ex, ex ? ex->currentPriority() : Priority::Normal);
+    }
+    void setExecutor(Executor* ex, Priority priority) {
+        executor_.set(ex, priority);
+    }
+
+    Priority priority() const noexcept { return executor_.bits(); }
 
     /// Requests the cancellation of the running task.
     ///
@@ -330,16 +359,17 @@ class BasePromise : private TaskFrame, public IntrusiveListItem<BasePromise> {
         // Prevent further doResume()s from scheduling the task again
         onResume<&BasePromise::doNothing>();
 
-        executor_->runSoon(
+        executor_.ptr()->runSoon(
                 +[](void* arg) noexcept {
                     auto h = CoroutineHandle<BasePromise>::from_address(arg);
                     BasePromise& self = h.promise();
                     CORRAL_TRACE("pr %p resumed", &self);
                     self.state_ = State::Running;
-                    auto guard = self.executor_->markActive(self.proxyHandle());
+                    auto guard = self.executor_.ptr()->markActive(
+                            self.proxyHandle(), self.executor_.bits());
                     h.resume();
                 },
-                realHandle().address());
+                realHandle().address(), executor_.bits());
     }
 
     /// Called when this task's awaitee completes after its cancellation was
@@ -393,7 +423,7 @@ class BasePromise : private TaskFrame, public IntrusiveListItem<BasePromise> {
         }
         checker_.aboutToSetExecutor();
         if constexpr (NeedsExecutor<Awaitee>) {
-            awaitee.await_set_executor(executor_);
+            awaitee.await_set_executor(executor_.ptr());
         }
 
         try {
@@ -419,7 +449,8 @@ class BasePromise : private TaskFrame, public IntrusiveListItem<BasePromise> {
     }
 
   private /*fields*/:
-    Executor* executor_ = nullptr;
+    /// The executor, with the task's priority in the spare low bits.
+    PointerBits<Executor, Priority, 2> executor_;
     BaseTaskParent* parent_ = nullptr;
 
     // These enums live in a union with Awaitee, so their values must
@@ -502,6 +533,9 @@ class BasePromise : private TaskFrame, public IntrusiveListItem<BasePromise> {
   public:
     CORRAL_NOINLINE auto initial_suspend() noexcept {
         pc = reinterpret_cast<uintptr_t>(CORRAL_RETURN_ADDRESS());
+#ifdef CORRAL_FRAME_PROFILER
+        FrameProfiler::attach(realHandle().address(), pc);
+#endif
         return std::suspend_always{};
     }
 
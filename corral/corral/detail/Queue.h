@@ -24,129 +24,276 @@
 
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
 
+#include <algorithm>
+#include <bit>
 #include <memory>
+#include <new>
 #include <span>
 #include <type_traits>
 #include <utility>
 
 namespace corral::detail {
 
+/// When should a Queue give back memory after a burst: once it has
+/// become empty `idleDrains` times in a row without having held more
+/// than a quarter of its capacity in between, its buffer is reallocated
+/// to twice the largest size seen meanwhile (but no less than
+/// `minCapacity`). `idleDrains == 0` means never.
+struct QueueShrinkPolicy {
+    size_t minCapacity = 0;
+    uint32_t idleDrains = 0;
+};
+
 /// A makeshift queue.
-/// Uses a circular buffer under the hood, so effectively zero-malloc (after
-/// the initial allocation), provided elements are dequeued with a decent pace
-/// to keep number of elements in the queue small.
+/// Uses a power-of-two circular buffer under the hood, so effectively
+/// zero-malloc (after the initial allocation), provided elements are
+/// dequeued with a decent pace to keep number of elements in the queue small.
 template <class T>
     requires(std::is_nothrow_destructible_v<T>)
 class Queue {
-    T* buffer_;
-    size_t capacity_;
-    T* head_;
-    T* tail_;
-    size_t size_;
+    T* buffer_ = nullptr;
+    size_t capacity_ = 0; // zero or a power of two
+    size_t head_ = 0;     // always < capacity_, unless capacity_ == 0
+    size_t size_ = 0;
+
+    // Shrinking
+    QueueShrinkPolicy policy_;
+    size_t peak_ = 0; // largest size since the last reset of idle_
+    uint32_t idle_ = 0;
 
   public:
-    explicit Queue(size_t capacity)
-      : buffer_(static_cast<T*>(malloc(capacity * sizeof(T)))),
-        capacity_(capacity),
-        head_(buffer_),
-        tail_(buffer_),
-        size_(0) {}
+    /// Constructs an empty queue which does not own a buffer yet.
+    Queue() noexcept = default;
+
+    /// Constructs a queue with room for at least `capacity` elements.
+    explicit Queue(size_t capacity) {
+        if (capacity) {
+            capacity_ = std::bit_ceil(capacity);
+            buffer_ = allocate(capacity_);
+        }
+    }
 
     Queue(Queue<T>&& rhs) noexcept
       : buffer_(std::exchange(rhs.buffer_, nullptr)),
         capacity_(std::exchange(rhs.capacity_, 0)),
-        head_(std::exchange(rhs.head_, nullptr)),
-        tail_(std::exchange(rhs.tail_, nullptr)),
-        size_(std::exchange(rhs.size_, 0)) {}
+        head_(std::exchange(rhs.head_, 0)),
+        size_(std::exchange(rhs.size_, 0)),
+        policy_(rhs.policy_),
+        peak_(std::exchange(rhs.peak_, 0)),
+        idle_(std::exchange(rhs.idle_, 0)) {}
 
     Queue& operator=(Queue<T> rhs) noexcept {
-        std::swap(buffer_, rhs.buffer_);
-        std::swap(capacity_, rhs.capacity_);
-        std::swap(head_, rhs.head_);
-        std::swap(tail_, rhs.tail_);
-        std::swap(size_, rhs.size_);
+        swap(rhs);
         return *this;
     }
 
     ~Queue() {
-        auto destroyRange = [](std::span<T> range) {
-            std::destroy(range.begin(), range.end());
-        };
-        destroyRange(first_range());
-        destroyRange(second_range());
-        free(buffer_);
+        clear();
+        ::operator delete(buffer_);
+    }
+
+    void swap(Queue<T>& rhs) noexcept {
+        std::swap(buffer_, rhs.buffer_);
+        std::swap(capacity_, rhs.capacity_);
+        std::swap(head_, rhs.head_);
+        std::swap(size_, rhs.size_);
+        std::swap(policy_, rhs.policy_);
+        std::swap(peak_, rhs.peak_);
+        std::swap(idle_, rhs.idle_);
     }
 
     size_t capacity() const { return capacity_; }
     size_t size() const { return size_; }
     bool empty() const { return size_ == 0; }
 
-    T& front() { return *head_; }
+    void setShrinkPolicy(QueueShrinkPolicy policy) noexcept {
+        policy_ = policy;
+        idle_ = 0;
+    }
+
+    T& front() { return buffer_[head_]; }
+    T& back() { return buffer_[index(size_ - 1)]; }
+
     void pop_front() {
-        head_->~T();
-        if (++head_ == buffer_ + capacity_) {
-            head_ = buffer_;
+        buffer_[head_].~T();
+        head_ = (head_ + 1) & (capacity_ - 1);
+        if (--size_ == 0) [[unlikely]] {
+            onDrained();
+        }
+    }
+
+    void pop_back() {
+        buffer_[index(size_ - 1)].~T();
+        if (--size_ == 0) [[unlikely]] {
+            onDrained();
         }
-        --size_;
     }
 
     template <class U> void push_back(U&& u) {
-        if (size_ == capacity_) {
-            grow();
+        emplace_back(std::forward<U>(u));
+    }
+
+    template <class... Args> void emplace_back(Args&&... args) {
+        if (size_ == capacity_) [[unlikely]] {
+            reallocate(std::max<size_t>(8, capacity_ * 2));
         }
-        new (tail_) T(std::forward<U>(u));
-        if (++tail_ == buffer_ + capacity_) {
-            tail_ = buffer_;
+        new (buffer_ + index(size_)) T(std::forward<Args>(args)...);
+        if (++size_ > peak_) {
+            peak_ = size_;
         }
-        ++size_;
     }
 
-    template <class... Args> void emplace_back(Args&&... args) {
-        if (size_ == capacity_) {
-            grow();
+    /// Makes sure `n` elements fit without further allocations.
+    void reserve(size_t n) {
+        if (n > capacity_) {
+            reallocate(std::bit_ceil(n));
         }
-        new (tail_) T(std::forward<Args>(args)...);
-        if (++tail_ == buffer_ + capacity_) {
-            tail_ = buffer_;
+    }
+
+    /// Appends `n` elements, taken from `first` onwards,
+    /// allocating at most once.
+    template <class It> void push_back_n(It first, size_t n) {
+        reserve(size_ + n);
+        for (size_t i = 0; i < n; ++i, ++first) {
+            new (buffer_ + index(size_)) T(*first);
+            ++size_;
+        }
+        peak_ = std::max(peak_, size_);
+    }
+
+    /// Moves up to `n` elements from the front of the queue to `out`,
+    /// and returns the advanced output iterator.
+    template <class OutIt> OutIt pop_front_n(size_t n, OutIt out) {
+        n = std::min(n, size_);
+        for (size_t i = 0; i < n; ++i, ++out) {
+            *out = std::move(buffer_[head_]);
+            buffer_[head_].~T();
+            head_ = (head_ + 1) & (capacity_ - 1);
+        }
+        size_ -= n;
+        if (n && size_ == 0) {
+            onDrained();
         }
-        ++size_;
+        return out;
+    }
+
+    /// Moves all elements of `other` to the back of this queue, leaving
+    /// `other` empty. If this queue is empty, the buffers are swapped
+    /// instead, so no elements are moved.
+    void splice(Queue<T>& other) {
+        if (other.empty()) {
+            return;
+        }
+        if (empty() && other.capacity_ >= capacity_) {
+            std::swap(buffer_, other.buffer_);
+            std::swap(capacity_, other.capacity_);
+            std::swap(head_, other.head_);
+            std::swap(size_, other.size_);
+        } else {
+            reserve(size_ + other.size_);
+            auto moveRange = [&](std::span<T> range) {
+                for (T& t : range) {
+                    new (buffer_ + index(size_)) T(std::move_if_noexcept(t));
+                    ++size_;
+                }
+            };
+            moveRange(other.first_range());
+            moveRange(other.second_range());
+            other.clear();
+        }
+        peak_ = std::max(peak_, size_);
+    }
+
+    /// Destroys all elements, keeping the buffer.
+    void clear() noexcept {
+        auto destroyRange = [](std::span<T> range) {
+            std::destroy(range.begin(), range.end());
+        };
+        destroyRange(first_range());
+        destroyRange(second_range());
+        head_ = size_ = 0;
     }
 
   private:
+    static T* allocate(size_t capacity) {
+        return static_cast<T*>(::operator new(capacity * sizeof(T)));
+    }
+
+    size_t index(size_t offset) const noexcept {
+        return (head_ + offset) & (capacity_ - 1);
+    }
+
     std::span<T> first_range() {
         if (empty()) {
             return {};
-        } else if (head_ < tail_) {
-            return {head_, tail_};
-        } else {
-            return {head_, buffer_ + capacity_};
         }
+        return {buffer_ + head_, std::min(size_, capacity_ - head_)};
     }
 
     std::span<T> second_range() {
-        if (empty() || head_ < tail_) {
+        if (empty() || head_ + size_ <= capacity_) {
             return {};
-        } else {
-            return {buffer_, tail_};
         }
+        return {buffer_, head_ + size_ - capacity_};
     }
 
-    void grow() {
-        Queue q(std::max<size_t>(8, capacity_ * 2));
+    void reallocate(size_t capacity) {
+        capacity = std::bit_ceil(capacity);
+        T* buf = allocate(capacity);
+        size_t moved = 0;
         auto moveRange = [&](std::span<T> range) {
-            if constexpr (std::is_nothrow_move_constructible_v<T>) {
-                q.tail_ = std::uninitialized_move(range.begin(), range.end(),
-                                                  q.tail_);
+            if constexpr (std::is_nothrow_move_constructible_v<T> ||
+                          !std::is_copy_constructible_v<T>) {
+                std::uninitialized_move(range.begin(), range.end(),
+                                        buf + moved);
             } else {
-                q.tail_ = std::uninitialized_copy(range.begin(), range.end(),
-                                                  q.tail_);
+                std::uninitialized_copy(range.begin(), range.end(),
+                                        buf + moved);
             }
-            q.size_ += range.size();
+            moved += range.size();
         };
-        moveRange(first_range());
-        moveRange(second_range());
-        *this = std::move(q);
+        try {
+            moveRange(first_range());
+            moveRange(second_range());
+        } catch (...) {
+            std::destroy_n(buf, moved);
+            ::operator delete(buf);
+            throw;
+        }
+        clear();
+        ::operator delete(buffer_);
+        buffer_ = buf;
+        capacity_ = capacity;
+        size_ = moved;
+    }
+
+    void onDrained() noexcept {
+        head_ = 0;
+        if (policy_.idleDrains == 0) {
+            return;
+        }
+        if (peak_ > capacity_ / 4) {
+            idle_ = 0;
+            peak_ = 0;
+        } else if (++idle_ >= policy_.idleDrains) {
+            size_t target = std::max<size_t>(
+                    std::bit_ceil(std::max(policy_.minCapacity, peak_ * 2)),
+                    1);
+            if (target < capacity_) {
+                // Nothing to move, so just swap the buffer for a smaller one
+                // (if that fails, there's no harm in keeping the old one).
+                if (T* buf = static_cast<T*>(::operator new(
+                            target * sizeof(T), std::nothrow))) {
+                    ::operator delete(buffer_);
+                    buffer_ = buf;
+                    capacity_ = target;
+                }
+            }
+            idle_ = 0;
+            peak_ = 0;
+        }
     }
 };
 
@@ -0,0 +1,86 @@
+// This file is part of corral, a lightweight C++20 coroutine library.
+//
+// Copyright (c) 2024 Hudson River Trading LLC <opensource@hudson-trading.com>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+// SPDX-License-Identifier: MIT
+
+#pragma once
+#include <atomic>
+
+namespace corral::detail {
+
+/// An item which can be linked into a RemoteQueue.
+template <class T> class RemoteQueueItem {
+    T* remoteNext_ = nullptr;
+    template <class> friend class RemoteQueue;
+};
+
+/// An intrusive lock-free multiple-producer, single-consumer queue.
+///
+/// Producers (any thread) push onto a Treiber stack; the consumer takes
+/// the whole stack at once and reverses it, so items come out in the
+/// order they were pushed. Since the consumer never pops individual
+/// items, there is no ABA problem to worry about.
+template <class T> class RemoteQueue {
+  public:
+    /// Pushes an item; may be called from any thread.
+    /// Returns true if the queue was empty, i.e., if the caller is
+    /// the one responsible for getting the consumer to run.
+    bool push(T& item) noexcept {
+        RemoteQueueItem<T>& link = item;
+        T* head = head_.load(std::memory_order_relaxed);
+        do {
+            link.remoteNext_ = head;
+        } while (!head_.compare_exchange_weak(head, &item,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed));
+        return head == nullptr;
+    }
+
+    /// Takes all items pushed so far, and calls `fn(T&)` for each of them,
+    /// oldest first. `fn` may destroy the item it was passed.
+    /// Must only be called from the consumer thread.
+    template <class Fn> void takeAll(Fn fn) {
+        T* head = head_.exchange(nullptr, std::memory_order_acquire);
+        T* oldest = nullptr;
+        while (head) {
+            RemoteQueueItem<T>& link = *head;
+            T* next = link.remoteNext_;
+            link.remoteNext_ = oldest;
+            oldest = head;
+            head = next;
+        }
+        while (oldest) {
+            T* next = static_cast<RemoteQueueItem<T>&>(*oldest).remoteNext_;
+            fn(*oldest);
+            oldest = next;
+        }
+    }
+
+    bool empty() const noexcept {
+        return head_.load(std::memory_order_acquire) == nullptr;
+    }
+
+  private:
+    std::atomic<T*> head_{nullptr};
+};
+
+} // namespace corral::detail
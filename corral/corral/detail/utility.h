@@ -944,6 +944,33 @@ struct CallableSignature : CallableSignature<decltype(&Fn::operator())> {
     static constexpr const bool IsMemFunPtr = false;
 };
 
+// HasCallableSignature<Fn> tells whether CallableSignature<Fn> can be
+// used, i.e., whether Fn is one of the forms specialized above (and not,
+// say, a ref-qualified or volatile member function pointer, or a class
+// with an overloaded or templated operator()).
+template <class Fn> struct HasCallableSignatureImpl : std::false_type {};
+template <class R, class S, class... Args>
+struct HasCallableSignatureImpl<R (S::*)(Args...)> : std::true_type {};
+template <class R, class S, class... Args>
+struct HasCallableSignatureImpl<R (S::*)(Args...) noexcept> : std::true_type {};
+template <class R, class S, class... Args>
+struct HasCallableSignatureImpl<R (S::*)(Args...) const> : std::true_type {};
+template <class R, class S, class... Args>
+struct HasCallableSignatureImpl<R (S::*)(Args...) const noexcept>
+  : std::true_type {};
+template <class R, class... Args>
+struct HasCallableSignatureImpl<R (*)(Args...)> : std::true_type {};
+template <class R, class... Args>
+struct HasCallableSignatureImpl<R (*)(Args...) noexcept> : std::true_type {};
+
+template <class Fn>
+concept HasCallableSignature =
+        HasCallableSignatureImpl<std::remove_cvref_t<Fn>>::value ||
+        (std::is_class_v<std::remove_cvref_t<Fn>> &&
+         requires { &std::remove_cvref_t<Fn>::operator(); } &&
+         HasCallableSignatureImpl<
+                 decltype(&std::remove_cvref_t<Fn>::operator())>::value);
+
 
 } // namespace detail
 
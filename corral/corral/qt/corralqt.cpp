@@ -2,30 +2,16 @@
 #include "../corral.h"
 #include <QDebug>
 #include <QCoreApplication>
+#ifdef __linux__
+#include <cerrno>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
 
 corral::Nursery *CorralQt::g_defaultNursery=nullptr;
 std::vector<std::function<corral::Task<void>()>> *CorralQt::g_waitingStart=nullptr;
 // Corral::UnsafeNursery *CorralQt::g_nursery=nullptr;
 
-namespace corral {
-template <> struct EventLoopTraits<QCoreApplication> {
-    static EventLoopID eventLoopID(QCoreApplication& app) {
-        return EventLoopID(&app);
-    }
-    static void run(QCoreApplication& app) {
-        QObject::connect(&app, &QCoreApplication::aboutToQuit, []() {
-          // qDebug()<<"About to quit";
-          CorralQt::g_defaultNursery->cancel();
-        });
-        app.exec();
-    }
-    static void stop(QCoreApplication& app) {
-        // qDebug()<<"Stop core";
-        app.exit();
-    }
-};
-}
-
 void CorralQt::exec(QCoreApplication &app) {
   corral::run(app, mainNursery());
 }
@@ -57,22 +43,15 @@ bool detail::TimerInstance::start(Awaiter *awaiter, std::weak_ptr<TimerInstance>
     return true;
   }
   else {
-    int64_t sleep=m_delayNs-m_elapsed.nsecsElapsed();
-    if(sleep<=0) {
+    if(m_deadline<=TimerWheel::Clock::now()) {
       fired();
       return false;
     }
     else {
       m_awaiting.insert(awaiter);
-      if(!m_timer) {
-        m_timer=new QTimer;
-        m_timer->setSingleShot(true);
-        m_timer->connect(m_timer, &QTimer::timeout, [this, self]() {
-          // Makes sure timer instance is not destroyed while serving the fired event
-          if(auto ptr=self.lock())
-            ptr->fired();
-        });
-        m_timer->start(sleep/1000000);
+      if(!pending()) {
+        m_self=std::move(self);
+        QtTimerWheel::forThisThread().add(*this, m_deadline);
       }
       return true;
     }
@@ -81,16 +60,19 @@ bool detail::TimerInstance::start(Awaiter *awaiter, std::weak_ptr<TimerInstance>
 
 void detail::TimerInstance::stop(Awaiter *awaiter) {
   m_awaiting.remove(awaiter);
-  if(m_awaiting.isEmpty()) {
-    delete m_timer;
-    m_timer=nullptr;
-  }
+  if(m_awaiting.isEmpty())
+    cancel();
+}
+
+void detail::TimerInstance::expired() noexcept {
+  // Makes sure timer instance is not destroyed while serving the fired event
+  if(auto ptr=m_self.lock())
+    ptr->fired();
 }
 
 void detail::TimerInstance::fired() {
   m_fired=true;
-  delete m_timer;
-  m_timer=nullptr;
+  cancel();
   while(!m_awaiting.isEmpty()) {
     auto it=m_awaiting.begin();
     auto awaiting=*it;
@@ -98,3 +80,97 @@ void detail::TimerInstance::fired() {
     awaiting->onFired();
   }
 }
+
+detail::QtTimerWheel *&detail::QtTimerWheel::current() {
+  // A plain pointer, so nothing is destroyed at thread exit
+  static thread_local QtTimerWheel *wheel=nullptr;
+  return wheel;
+}
+
+detail::QtTimerWheel &detail::QtTimerWheel::forThisThread() {
+  QtTimerWheel *&wheel=current();
+  if(wheel)
+    return *wheel;
+  wheel=new QtTimerWheel;
+  QCoreApplication *app=QCoreApplication::instance();
+  QThread *thread=QThread::currentThread();
+  if(app && app->thread()==thread) {
+    wheel->setParent(app);
+  } else {
+    // Emitted from the finishing thread, before its event dispatcher
+    // goes away. Threads not started by QThread never emit it, and
+    // keep their wheel until the process exits.
+    QObject::connect(thread, &QThread::finished, wheel,
+                     [wheel]() { delete wheel; }, Qt::DirectConnection);
+  }
+  return *wheel;
+}
+
+detail::QtTimerWheel::QtTimerWheel() {
+#ifdef __linux__
+  // steady_clock is CLOCK_MONOTONIC, so deadlines can be passed as is
+  m_timerFd=timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+  if(m_timerFd>=0) {
+    m_notifier=new QSocketNotifier(m_timerFd, QSocketNotifier::Read);
+    QObject::connect(m_notifier, &QSocketNotifier::activated, [this]() {
+      uint64_t expirations;
+      if(::read(m_timerFd, &expirations, sizeof(expirations))<0 && errno==EAGAIN)
+        return; // disarmed or re-armed meanwhile
+      onTimeout();
+    });
+    return;
+  }
+  qWarning()<<"timerfd_create() failed, falling back to QTimer";
+#endif
+  m_timer.setSingleShot(true);
+  m_timer.setTimerType(Qt::PreciseTimer);
+  QObject::connect(&m_timer, &QTimer::timeout, [this]() { onTimeout(); });
+}
+
+detail::QtTimerWheel::~QtTimerWheel() {
+  if(current()==this)
+    current()=nullptr;
+  delete m_notifier;
+#ifdef __linux__
+  if(m_timerFd>=0)
+    ::close(m_timerFd);
+#endif
+}
+
+void detail::QtTimerWheel::add(TimerWheel::Entry &entry, TimerWheel::Clock::time_point deadline) {
+  m_wheel.add(entry, deadline);
+  // Cancelled entries are not tracked; at worst the timer fires for nothing
+  if(m_wheel.nextExpiry()<m_armedFor)
+    rearm();
+}
+
+void detail::QtTimerWheel::onTimeout() {
+  m_armedFor=TimerWheel::Clock::time_point::max();
+  m_wheel.advance();
+  // Entries added while expiring others re-armed the timer already
+  if(m_armedFor==TimerWheel::Clock::time_point::max())
+    rearm();
+}
+
+void detail::QtTimerWheel::rearm() {
+  m_armedFor=m_wheel.nextExpiry();
+#ifdef __linux__
+  if(m_timerFd>=0) {
+    itimerspec spec{};
+    if(!m_wheel.empty()) {
+      auto ns=std::chrono::duration_cast<std::chrono::nanoseconds>(m_armedFor.time_since_epoch()).count();
+      ns=std::max<int64_t>(ns, 1); // all zeroes would disarm
+      spec.it_value.tv_sec=ns/1000000000;
+      spec.it_value.tv_nsec=ns%1000000000;
+    }
+    timerfd_settime(m_timerFd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    return;
+  }
+#endif
+  if(m_wheel.empty()) {
+    m_timer.stop();
+    return;
+  }
+  auto delay=std::chrono::ceil<std::chrono::milliseconds>(m_armedFor-TimerWheel::Clock::now());
+  m_timer.start(std::max<int>(0, int(std::min<int64_t>(delay.count(), std::numeric_limits<int>::max()))));
+}
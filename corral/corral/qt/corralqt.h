@@ -2,29 +2,59 @@
 #include <limits>
 #include "../corral.h"
 #include <QDebug>
-class QCoreApplication;
+#include <QCoreApplication>
 #include <QTimer>
 #include <QElapsedTimer>
+#include <QSocketNotifier>
+#include <QThread>
+#include "corraltimerwheel.h"
 
 namespace detail {
+/// The timer wheel of the current thread, driven by a single timer
+/// which is armed for the wheel's next expiry. On Linux, this is a
+/// timerfd watched by a QSocketNotifier, which has nanosecond
+/// resolution; elsewhere (or if timerfd_create() fails) a QTimer
+/// with Qt::PreciseTimer, which only has millisecond resolution.
+///
+/// The wheel must go away while the thread's event dispatcher is still
+/// there, so it is not left to thread_local destruction: on the main
+/// thread it is a child of the QCoreApplication, and on other threads
+/// it is deleted once their QThread finishes. Timers still pending by
+/// then never fire.
+class QtTimerWheel: public QObject {
+public:
+  static QtTimerWheel &forThisThread();
+  ~QtTimerWheel() override;
+  /// Arms `entry` (see TimerWheel::add()).
+  void add(TimerWheel::Entry &entry, TimerWheel::Clock::time_point deadline);
+private:
+  QtTimerWheel();
+  static QtTimerWheel *&current();
+  void onTimeout();
+  void rearm();
+  TimerWheel m_wheel;
+  int m_timerFd=-1;
+  QSocketNotifier *m_notifier=nullptr;
+  QTimer m_timer;
+  TimerWheel::Clock::time_point m_armedFor=TimerWheel::Clock::time_point::max();
+};
+
 class Timer;
-class TimerInstance {
+class TimerInstance: private TimerWheel::Entry {
   friend class Timer;
 public:
   TimerInstance(int64_t delayNs): m_delayNs(delayNs) {
     if(delayNs==0)
       m_fired=true;
     else if(delayNs>0)
-      m_elapsed.start();
-  }
-  ~TimerInstance() {
-    delete m_timer;
+      m_deadline=TimerWheel::Clock::now()+std::chrono::nanoseconds(delayNs);
   }
 protected:
   struct Awaiter;
   bool start(Awaiter *awaiter, std::weak_ptr<TimerInstance> self);
   void stop(Awaiter *awaiter);
   void fired();
+  void expired() noexcept override;
   struct Awaiter {
     Awaiter(std::shared_ptr<TimerInstance> timer): m_timer(timer) {}
     std::shared_ptr<TimerInstance> m_timer;
@@ -71,8 +101,8 @@ protected:
   };
   int64_t m_delayNs;
   bool m_fired=false;
-  QElapsedTimer m_elapsed;
-  QTimer *m_timer=nullptr;
+  TimerWheel::Clock::time_point m_deadline;
+  std::weak_ptr<TimerInstance> m_self;
   QSet<Awaiter *> m_awaiting;
 };
 
@@ -93,6 +123,62 @@ private:
   std::shared_ptr<TimerInstance> m_timer;
 };
 
+
+/// A single-use timer for qAwaitTimeout(): unlike Timer, it lives in
+/// the awaiting frame rather than on the heap, and its deadline is
+/// counted from the moment it is awaited. A negative delay never expires.
+class TimeoutTimer: private TimerWheel::Entry {
+public:
+  explicit TimeoutTimer(int64_t delayNs): m_delayNs(delayNs) {}
+  // Only to be moved before being awaited
+  TimeoutTimer(TimeoutTimer &&other): TimerWheel::Entry(), m_delayNs(other.m_delayNs) {}
+
+  bool await_ready() const noexcept { return m_delayNs==0; }
+  void await_suspend(corral::Handle h) {
+    m_suspended=h;
+    if(m_delayNs>0)
+      QtTimerWheel::forThisThread().add(*this, TimerWheel::Clock::now()+std::chrono::nanoseconds(m_delayNs));
+  }
+  void await_resume() {}
+  auto await_early_cancel() noexcept { return std::true_type{}; }
+  auto await_cancel(corral::Handle) noexcept {
+    cancel();
+    return std::true_type{};
+  }
+  auto await_must_resume() const noexcept { return std::false_type{}; }
+  void await_introspect(corral::detail::TaskTreeCollector &tree) const noexcept {
+    tree.node("QtTimer");
+  }
+private:
+  void expired() noexcept override { std::exchange(m_suspended, nullptr).resume(); }
+  int64_t m_delayNs;
+  corral::Handle m_suspended;
+};
+
+/// What qAwaitTimeout() returns: anyOf(TimeoutTimer, awaitable), with
+/// the result narrowed down to the awaitable's one.
+template <class Awaitable>
+class TimeoutAwaitable {
+  using Mux=decltype(corral::anyOf(std::declval<TimeoutTimer>(), std::declval<Awaitable>()));
+public:
+  using Result=std::optional<corral::detail::AwaitableReturnType<Awaitable>>;
+  TimeoutAwaitable(int64_t delayNs, Awaitable &&awaitable)
+    : m_mux(corral::anyOf(TimeoutTimer(delayNs), std::forward<Awaitable>(awaitable))) {}
+
+  bool await_ready() const noexcept { return m_mux.await_ready(); }
+  auto await_suspend(corral::Handle h) { return m_mux.await_suspend(h); }
+  Result await_resume() { return std::get<1>(std::move(m_mux).await_resume()); }
+  auto await_early_cancel() noexcept { return m_mux.await_early_cancel(); }
+  auto await_cancel(corral::Handle h) noexcept { return m_mux.await_cancel(h); }
+  auto await_must_resume() const noexcept { return m_mux.await_must_resume(); }
+  void await_set_executor(corral::Executor *ex) noexcept { m_mux.await_set_executor(ex); }
+  void await_introspect(corral::detail::TaskTreeCollector &tree) const noexcept {
+    m_mux.await_introspect(tree);
+  }
+private:
+  Mux m_mux;
+};
+
 }
 /// A utility function, returning an awaitable suspending the caller
 /// for specified duration. Suitable for use with anyOf() etc.
@@ -107,10 +193,123 @@ static inline auto qSleepForNs(int64_t ns) {
     return detail::Timer(ns);
 }
 
-template <class Awaitable, class R, class P> static inline corral::Task<std::optional<corral::detail::AwaitableReturnType<Awaitable>>> qAwaitTimeout(std::chrono::duration<R,P> delay, Awaitable &&awaitable) {
-  auto result=co_await corral::anyOf(qSleepFor(delay), std::move(awaitable));
-  co_await corral::yield;
-  co_return std::get<1>(result);
+/// Awaits `awaitable`, cancelling it if it does not complete within
+/// `delay`; returns its result, or std::nullopt on timeout. This is
+/// a plain awaitable, so costs no allocations.
+template <class Awaitable, class R, class P> static inline detail::TimeoutAwaitable<Awaitable> qAwaitTimeout(std::chrono::duration<R,P> delay, Awaitable &&awaitable) {
+  return detail::TimeoutAwaitable<Awaitable>(std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count(), std::forward<Awaitable>(awaitable));
+}
+
+namespace detail { struct DeadlineRunner; }
+
+/// A block of code running under a single deadline, see qWithDeadline().
+/// When the deadline passes, everything in the block gets cancelled.
+class DeadlineScope: private detail::TimerWheel::Entry {
+  friend struct detail::DeadlineRunner;
+public:
+  using Clock=detail::TimerWheel::Clock;
+
+  DeadlineScope(const DeadlineScope &)=delete;
+  DeadlineScope &operator=(const DeadlineScope &)=delete;
+
+  /// The deadline of the block, taking enclosing scopes into account.
+  Clock::time_point deadline() const {
+    return m_parent ? std::min(m_deadline, m_parent->deadline()) : m_deadline;
+  }
+  Clock::duration remaining() const {
+    return std::max(deadline()-Clock::now(), Clock::duration::zero());
+  }
+  /// True once this scope's own deadline has passed.
+  bool timedOut() const { return m_timedOut; }
+
+  /// Moves the deadline earlier; a later deadline is ignored, so
+  /// the block can never get more time than it was given.
+  void shrinkTo(Clock::time_point deadline) {
+    if(deadline>=m_deadline)
+      return;
+    m_deadline=deadline;
+    if(m_nursery && !m_timedOut && (pending() || !m_parent || m_deadline<m_parent->deadline()))
+      detail::QtTimerWheel::forThisThread().add(*this, m_deadline);
+  }
+  template <class R, class P>
+  void shrinkTo(std::chrono::duration<R, P> delay) {
+    shrinkTo(Clock::now()+std::chrono::duration_cast<Clock::duration>(delay));
+  }
+
+  /// Tasks started here run under the deadline too. Note that the block
+  /// waits for them before completing, as with any nursery.
+  corral::Nursery &nursery() { return *m_nursery; }
+
+private:
+  DeadlineScope(Clock::time_point deadline, DeadlineScope *parent)
+    : m_deadline(deadline), m_parent(parent) {}
+
+  void open(corral::Nursery &nursery) {
+    m_nursery=&nursery;
+    // A nested scope ending no earlier than its parent needs no timer
+    // of its own: the parent's one cancels it just as well.
+    if(!m_parent || m_deadline<m_parent->deadline())
+      detail::QtTimerWheel::forThisThread().add(*this, m_deadline);
+  }
+  void close() {
+    cancel();
+    m_nursery=nullptr;
+  }
+  void expired() noexcept override {
+    m_timedOut=true;
+    m_nursery->cancel();
+  }
+
+  Clock::time_point m_deadline;
+  DeadlineScope *m_parent;
+  corral::Nursery *m_nursery=nullptr;
+  bool m_timedOut=false;
+};
+
+namespace detail {
+struct DeadlineRunner {
+  template <class Callable>
+  using Result=std::optional<corral::detail::AwaitableReturnType<std::invoke_result_t<Callable, DeadlineScope &>>>;
+
+  template <class Callable>
+  static corral::Task<Result<Callable>> run(DeadlineScope::Clock::time_point deadline, DeadlineScope *parent, Callable callable) {
+    DeadlineScope scope(deadline, parent);
+    Result<Callable> result;
+    CORRAL_WITH_NURSERY(nursery) {
+      scope.open(nursery);
+      if constexpr(std::is_void_v<decltype(co_await callable(scope))>) {
+        co_await callable(scope);
+        result.emplace();
+      }
+      else {
+        result.emplace(co_await callable(scope));
+      }
+      co_return corral::join;
+    };
+    scope.close();
+    co_return result;
+  }
+};
+}
+
+/// Runs `callable(DeadlineScope &)` (an async function) under
+/// a deadline `delay` from now, using a single timer for the whole
+/// block however many operations it does. Returns the result, or
+/// std::nullopt if the deadline passed first (which cancels the block).
+///
+///    auto ok = co_await qWithDeadline(60s, [&](DeadlineScope &scope) -> corral::Task<bool> {
+///      co_await sendHeader(device);
+///      co_return co_await receiveBlocks(device);
+///    });
+template <class R, class P, class Callable>
+static inline auto qWithDeadline(std::chrono::duration<R, P> delay, Callable callable) {
+  return detail::DeadlineRunner::run(DeadlineScope::Clock::now()+std::chrono::duration_cast<DeadlineScope::Clock::duration>(delay), nullptr, std::move(callable));
+}
+/// Same as above, but nested in `parent`: the block gets at most
+/// `delay`, and never more than what is left of the parent's deadline.
+template <class R, class P, class Callable>
+static inline auto qWithDeadline(DeadlineScope &parent, std::chrono::duration<R, P> delay, Callable callable) {
+  return detail::DeadlineRunner::run(DeadlineScope::Clock::now()+std::chrono::duration_cast<DeadlineScope::Clock::duration>(delay), &parent, std::move(callable));
 }
 namespace details {
 template <typename T>
@@ -156,3 +355,26 @@ private:
   static std::vector<std::function<corral::Task<void>()>> *g_waitingStart;
   // static corral::UnsafeNursery *g_nursery;
 };
+
+namespace corral {
+template <> struct EventLoopTraits<QCoreApplication> {
+    static EventLoopID eventLoopID(QCoreApplication& app) {
+        return EventLoopID(&app);
+    }
+    static void run(QCoreApplication& app) {
+        QObject::connect(&app, &QCoreApplication::aboutToQuit, []() {
+          // qDebug()<<"About to quit";
+          CorralQt::g_defaultNursery->cancel();
+        });
+        app.exec();
+    }
+    static void stop(QCoreApplication& app) {
+        // qDebug()<<"Stop core";
+        app.exit();
+    }
+    static void post(QCoreApplication& app, void (*fn)(void*), void* arg) {
+        QMetaObject::invokeMethod(&app, [fn, arg]() { fn(arg); },
+                                  Qt::QueuedConnection);
+    }
+};
+}
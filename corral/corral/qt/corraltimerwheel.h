@@ -0,0 +1,202 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include "../detail/IntrusiveList.h"
+
+namespace detail {
+
+/// A hierarchical timing wheel: pending timers are hashed into one of
+/// `Levels` levels of 64 slots each, according to how far away they
+/// are, so arming or cancelling a timer is O(1) no matter how many of
+/// them are pending. Level 0 slots are one tick (1 us) wide, level 1
+/// slots 64 ticks wide, and so on; when time reaches a slot of an upper
+/// level, its timers are redistributed over the lower ones. Timers
+/// further out than the wheel covers (about 19 hours) wait in its
+/// last slot and get redistributed as time goes by.
+///
+/// The wheel knows nothing about event loops: its owner is expected to
+/// call advance() when nextExpiry() comes (see QtTimerWheel).
+class TimerWheel {
+public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr std::chrono::microseconds Tick{1};
+
+  /// A timer which can be armed in a TimerWheel. Timers round their
+  /// deadline up to a whole tick, so they never expire early.
+  class Entry : public corral::detail::IntrusiveListItem<Entry> {
+    friend class TimerWheel;
+  public:
+    Entry()=default;
+    Entry(const Entry &)=delete;
+    Entry &operator=(const Entry &)=delete;
+    ~Entry() { cancel(); }
+
+    bool pending() const { return m_wheel!=nullptr; }
+
+    /// Disarms the timer; does nothing if it is not pending.
+    void cancel() {
+      if(m_wheel)
+        m_wheel->remove(*this);
+    }
+  protected:
+    /// Called from TimerWheel::advance() once the deadline has passed;
+    /// the entry is no longer pending by then, and may be re-armed.
+    virtual void expired() noexcept=0;
+  private:
+    TimerWheel *m_wheel=nullptr;
+    uint64_t m_expiry=0; // in ticks since the wheel's origin
+    uint8_t m_level=0;   // == Levels if due to fire in advance()
+    uint8_t m_slot=0;
+  };
+
+  TimerWheel(): m_origin(Clock::now()) {}
+  TimerWheel(const TimerWheel &)=delete;
+  TimerWheel &operator=(const TimerWheel &)=delete;
+  ~TimerWheel() {
+    for(auto &level: m_slots) {
+      for(auto &slot: level) {
+        while(!slot.empty()) {
+          slot.front().m_wheel=nullptr;
+          slot.pop_front();
+        }
+      }
+    }
+  }
+
+  bool empty() const { return m_count==0; }
+  size_t size() const { return m_count; }
+
+  /// Arms `entry` to expire at `deadline`, re-arming it if it is
+  /// already pending.
+  void add(Entry &entry, Clock::time_point deadline) {
+    entry.cancel();
+    if(m_count==0) {
+      // Nothing to redistribute, so just catch up with the clock
+      m_now=std::max(m_now, ticksElapsed(Clock::now()));
+    }
+    auto sinceOrigin=std::max(deadline-m_origin, Clock::duration::zero());
+    uint64_t expiry=(sinceOrigin+Tick-Clock::duration(1))/Tick;
+    // The current tick has been processed already
+    entry.m_expiry=std::max(expiry, m_now+1);
+    entry.m_wheel=this;
+    ++m_count;
+    insert(entry);
+  }
+
+  /// Returns when advance() needs to be called next, which may be in
+  /// the past; Clock::time_point::max() if nothing is pending.
+  /// This may be earlier than any timer's deadline, as advance() also
+  /// needs to be called to redistribute the timers of upper levels.
+  Clock::time_point nextExpiry() const {
+    uint64_t tick=nextEventTick();
+    if(tick==NoTick)
+      return Clock::time_point::max();
+    return m_origin+Clock::duration(Tick)*int64_t(tick);
+  }
+
+  /// Expires every timer whose deadline is at or before `now`.
+  void advance(Clock::time_point now=Clock::now()) {
+    uint64_t target=ticksElapsed(now);
+    Slot due;
+    for(;;) {
+      uint64_t next=nextEventTick();
+      if(next>target)
+        break;
+      m_now=next;
+      // Top-down, so timers which fall through several levels at
+      // once end up where they belong
+      for(int level=Levels-1; level>0; --level) {
+        if(m_now&((uint64_t(1)<<(level*LevelBits))-1))
+          continue;
+        Slot cascading;
+        cascading.splice(takeSlot(level, (m_now>>(level*LevelBits))&SlotMask));
+        while(!cascading.empty()) {
+          Entry &entry=cascading.front();
+          cascading.pop_front();
+          insert(entry);
+        }
+      }
+      Slot &slot=takeSlot(0, m_now&SlotMask);
+      for(Entry &entry: slot)
+        entry.m_level=Levels;
+      due.splice(slot);
+    }
+    m_now=std::max(m_now, target);
+
+    while(!due.empty()) {
+      Entry &entry=due.front();
+      due.pop_front();
+      entry.m_wheel=nullptr;
+      --m_count;
+      entry.expired();
+    }
+  }
+
+private:
+  static constexpr int LevelBits=6;
+  static constexpr int Levels=6;
+  static constexpr unsigned Slots=1u<<LevelBits;
+  static constexpr uint64_t SlotMask=Slots-1;
+  static constexpr uint64_t Span=uint64_t(1)<<(Levels*LevelBits);
+  static constexpr uint64_t NoTick=std::numeric_limits<uint64_t>::max();
+  using Slot=corral::detail::IntrusiveList<Entry>;
+
+  uint64_t ticksElapsed(Clock::time_point t) const {
+    return t>m_origin ? uint64_t((t-m_origin)/Tick) : 0;
+  }
+
+  /// Puts a pending entry into the slot matching its expiry.
+  void insert(Entry &entry) {
+    uint64_t expiry=entry.m_expiry;
+    uint64_t delta=expiry>m_now ? expiry-m_now : 0;
+    int level=0;
+    while(level<Levels-1 && delta>=(uint64_t(1)<<((level+1)*LevelBits)))
+      ++level;
+    if(delta>=Span)
+      expiry=m_now+Span-1; // park in the furthest slot for now
+    unsigned slot=(expiry>>(level*LevelBits))&SlotMask;
+    entry.m_level=uint8_t(level);
+    entry.m_slot=uint8_t(slot);
+    m_slots[level][slot].push_back(entry);
+    m_occupied[level]|=uint64_t(1)<<slot;
+  }
+
+  void remove(Entry &entry) {
+    entry.unlink();
+    if(entry.m_level<Levels && m_slots[entry.m_level][entry.m_slot].empty())
+      m_occupied[entry.m_level]&=~(uint64_t(1)<<entry.m_slot);
+    entry.m_wheel=nullptr;
+    --m_count;
+  }
+
+  Slot &takeSlot(int level, unsigned slot) {
+    m_occupied[level]&=~(uint64_t(1)<<slot);
+    return m_slots[level][slot];
+  }
+
+  /// Returns the first tick after m_now at which a non-empty slot
+  /// comes up, at any level.
+  uint64_t nextEventTick() const {
+    uint64_t ret=NoTick;
+    for(int level=0; level<Levels; ++level) {
+      if(!m_occupied[level])
+        continue;
+      uint64_t base=m_now>>(level*LevelBits);
+      uint64_t rotated=std::rotr(m_occupied[level], int((base+1)&SlotMask));
+      uint64_t next=base+1+std::countr_zero(rotated);
+      ret=std::min(ret, next<<(level*LevelBits));
+    }
+    return ret;
+  }
+
+  Slot m_slots[Levels][Slots];
+  uint64_t m_occupied[Levels]={};
+  Clock::time_point m_origin;
+  uint64_t m_now=0; // last tick processed
+  size_t m_count=0;
+};
+
+}